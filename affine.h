@@ -0,0 +1,121 @@
+#pragma once
+
+#include "return_queue.h"
+
+#include <type_traits>
+
+class AffineHook;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Owner-thread-affine destruction: an object released by a thread other than the one that
+// created it is handed back to its home thread, which destroys and frees it at the next drain
+// point. The memory then returns to the allocator cache of the thread that allocated it,
+// instead of taking the cross-thread free path.
+//
+// Drain points: `AffineHome::DrainCurrent()`, creation of another affine object on the home
+// thread, and the exit of the home thread. Objects whose home thread is gone, and objects
+// created while their thread exits, are destroyed in place. Because creation drains, creating
+// an affine object may run the destructors of others, see `AffineHook()`.
+
+using AffineHome = ThreadReturnQueue<AffineHook>;
+
+// Lives inside the object or its control block and remembers the creating thread.
+// Copies belong to the thread that makes them.
+class AffineHook {
+    friend AffineHome;
+
+public:
+    // A drain point, so the memory of returned objects is reused by the allocations that
+    // follow. Objects returned by other threads are destroyed here, inside the `new` or
+    // `MakeShared` of an unrelated object: their destructors must not take locks that the
+    // creating code may hold.
+    AffineHook() : home_(AffineHome::Current()) {
+        if (home_) {
+            home_->Ref();
+            home_->Drain();
+        }
+    }
+
+    AffineHook(const AffineHook&) : AffineHook() {
+    }
+
+    AffineHook& operator=(const AffineHook&) {
+        return *this;
+    }
+
+    ~AffineHook() {
+        if (home_) {
+            home_->Unref();
+        }
+    }
+
+    // `destroy(object)` destroys the object holding this hook, on the home thread
+    void Release(void* object, void (*destroy)(void*)) {
+        if (!home_ || AffineHome::IsCurrent(home_)) {
+            destroy(object);
+            return;
+        }
+        object_ = object;
+        destroy_ = destroy;
+        if (!home_->Push(this)) {
+            destroy(object);
+        }
+    }
+
+private:
+    // The hook is destroyed along with its object
+    static void OnReturned(AffineHook* hook) {
+        hook->destroy_(hook->object_);
+    }
+
+    AffineHome* home_;
+    AffineHook* next_ = nullptr;
+    void* object_ = nullptr;
+    void (*destroy_)(void*) = nullptr;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Integration with `RefCounted`:
+// `struct Node : ThreadSafeRefCounted<Node, AffineDelete>, ThreadAffine {}`
+
+class ThreadAffine {
+public:
+    AffineHook affine_hook_;
+};
+
+// A `Deleter` for `RefCounted` and a deleter for `SharedPtr` and `UniquePtr`
+struct AffineDelete {
+    template <typename T>
+    void operator()(T* object) const {
+        Destroy(object);
+    }
+
+    template <typename T>
+    static void Destroy(T* object) {
+        static_assert(std::is_base_of_v<ThreadAffine, T>, "AffineDelete needs a ThreadAffine base");
+        if (!object) {
+            return;
+        }
+        object->affine_hook_.Release(object, [](void* pointer) {
+            delete static_cast<T*>(pointer);
+        });
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Policy wrapper: objects of `SharedPtr<T, OwnerThreadDestruction<Policy>>` are destroyed and
+// their blocks released on the thread that created the block. The hook rides on the counter.
+
+template <class Counter>
+class AffineCounter : public Counter, public AffineHook {};
+
+template <class Policy>
+struct OwnerThreadDestruction : Policy {
+    using Counter = AffineCounter<typename Policy::Counter>;
+
+    static constexpr bool kOwnerThreadDestruction = true;
+};
+
+template <class Policy>
+inline constexpr bool kDestroysOnOwnerThread =
+    requires { requires Policy::kOwnerThreadDestruction; };
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "shared.h"
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <utility>
+
+// https://en.cppreference.com/w/cpp/memory/shared_ptr/atomic2
+// Lock-free holder of a `SharedPtr` based on split reference counting.
+// The current value lives in a node, the atomic word packs the node address with
+// the number of readers currently copying from it. A replaced node is freed by whoever
+// finishes last: the writer that replaced it or the last of the readers it counted.
+// Every `Store` allocates a node, so readers never meet a reused address.
+// The reader count takes the 16 bits above the address: 65536 readers copying at once
+// terminate the process, like an overflowing `PackedCounter`.
+template <typename T, typename Policy = DefaultSharedPolicy>
+class AtomicSharedPtr {
+    static_assert(sizeof(uintptr_t) == 8, "Pointer bits are packed with a counter");
+
+public:
+    AtomicSharedPtr() {
+    }
+
+    AtomicSharedPtr(SharedPtr<T, Policy> value) : word_(Pack(new Node{std::move(value)})) {
+    }
+
+    AtomicSharedPtr(const AtomicSharedPtr&) = delete;
+    AtomicSharedPtr& operator=(const AtomicSharedPtr&) = delete;
+
+    ~AtomicSharedPtr() {
+        delete GetNode(word_.load(std::memory_order_acquire));
+    }
+
+    static constexpr bool IsLockFree() {
+        return std::atomic<uintptr_t>::is_always_lock_free;
+    }
+
+    SharedPtr<T, Policy> Load() const {
+        Node* node = Protect();
+        SharedPtr<T, Policy> result;
+        if (node) {
+            result = node->value;
+        }
+        Unprotect(node);
+        return result;
+    }
+
+    void Store(SharedPtr<T, Policy> desired) {
+        Exchange(std::move(desired));
+    }
+
+    SharedPtr<T, Policy> Exchange(SharedPtr<T, Policy> desired) {
+        uintptr_t word = word_.exchange(Pack(new Node{std::move(desired)}), std::memory_order_acq_rel);
+        Node* node = GetNode(word);
+        if (!node) {
+            return SharedPtr<T, Policy>();
+        }
+        if (GetReaders(word) == 0) {
+            // Readers already released it through the word, nobody else can see the node
+            SharedPtr<T, Policy> result = std::move(node->value);
+            delete node;
+            return result;
+        }
+        SharedPtr<T, Policy> result = node->value;
+        Retire(node, GetReaders(word));
+        return result;
+    }
+
+    // Replaces the value if it shares both the object and the block with `expected`,
+    // otherwise loads the current value into `expected`
+    bool CompareExchange(SharedPtr<T, Policy>& expected, SharedPtr<T, Policy> desired) {
+        Node* replacement = nullptr;
+        while (true) {
+            Node* node = Protect();
+            if (!Holds(node, expected)) {
+                expected = node ? node->value : SharedPtr<T, Policy>();
+                Unprotect(node);
+                delete replacement;
+                return false;
+            }
+            if (!replacement) {
+                replacement = new Node{std::move(desired)};
+            }
+            uintptr_t word = word_.load(std::memory_order_relaxed);
+            while (GetNode(word) == node) {
+                if (word_.compare_exchange_weak(word, Pack(replacement), std::memory_order_acq_rel,
+                                                std::memory_order_relaxed)) {
+                    if (node) {
+                        // Our own protection is dropped together with the node
+                        Retire(node, GetReaders(word) - 1);
+                    }
+                    return true;
+                }
+            }
+            Unprotect(node);
+        }
+    }
+
+private:
+    struct Node {
+        SharedPtr<T, Policy> value;
+        // Readers counted in the word but not yet finished, minus those already finished
+        std::atomic<int64_t> refs = 0;
+    };
+
+    static constexpr int kAddressBits = 48;
+    static constexpr uintptr_t kAddressMask = (uintptr_t{1} << kAddressBits) - 1;
+    static constexpr uintptr_t kReader = uintptr_t{1} << kAddressBits;
+    static constexpr uintptr_t kMaxReaders = ~uintptr_t{0} >> kAddressBits;
+
+    static uintptr_t Pack(Node* node) {
+        return reinterpret_cast<uintptr_t>(node);
+    }
+
+    static Node* GetNode(uintptr_t word) {
+        return reinterpret_cast<Node*>(word & kAddressMask);
+    }
+
+    static int64_t GetReaders(uintptr_t word) {
+        return word >> kAddressBits;
+    }
+
+    static bool Holds(Node* node, const SharedPtr<T, Policy>& value) {
+        if (!node) {
+            return !value.block_ && !value.ptr_;
+        }
+        return node->value.block_ == value.block_ && node->value.ptr_ == value.ptr_;
+    }
+
+    Node* Protect() const {
+        uintptr_t word = word_.fetch_add(kReader, std::memory_order_acquire);
+        // The count wrapped to zero, a writer would free the node under its readers
+        if (static_cast<uintptr_t>(GetReaders(word)) == kMaxReaders) {
+            std::terminate();
+        }
+        return GetNode(word);
+    }
+
+    void Unprotect(Node* node) const {
+        uintptr_t word = word_.load(std::memory_order_relaxed);
+        while (GetNode(word) == node) {
+            if (word_.compare_exchange_weak(word, word - kReader, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+                return;
+            }
+        }
+        // The node was replaced, its writer moved our count into `refs`
+        if (node && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete node;
+        }
+    }
+
+    static void Retire(Node* node, int64_t readers) {
+        if (node->refs.fetch_add(readers, std::memory_order_acq_rel) + readers == 0) {
+            delete node;
+        }
+    }
+
+    mutable std::atomic<uintptr_t> word_ = 0;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "intrusive.h"
+#include "shared.h"
+#include "unique.h"
+#include "weak.h"
+
+#include <memory>
+#include <utility>
+
+// The same benchmark body runs on library pointers and their `std::` equivalents
+
+struct Payload {
+    int value = 0;
+};
+
+template <typename Policy = DefaultSharedPolicy>
+struct Ours {
+    template <typename T>
+    using Shared = SharedPtr<T, Policy>;
+
+    template <typename T>
+    using Weak = WeakPtr<T, Policy>;
+
+    template <typename T, typename... Args>
+    static Shared<T> Make(Args&&... args) {
+        return MakeShared<T, Policy>(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    static Shared<T> Lock(const Weak<T>& weak) {
+        return weak.Lock();
+    }
+
+    template <typename T>
+    static void Reset(Shared<T>& ptr) {
+        ptr.Reset();
+    }
+};
+
+struct Std {
+    template <typename T>
+    using Shared = std::shared_ptr<T>;
+
+    template <typename T>
+    using Weak = std::weak_ptr<T>;
+
+    template <typename T, typename... Args>
+    static Shared<T> Make(Args&&... args) {
+        return std::make_shared<T>(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    static Shared<T> Lock(const Weak<T>& weak) {
+        return weak.lock();
+    }
+
+    template <typename T>
+    static void Reset(Shared<T>& ptr) {
+        ptr.reset();
+    }
+};
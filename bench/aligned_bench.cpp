@@ -0,0 +1,78 @@
+#include "unique.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+// Eight lanes, one AVX register (two SSE ones without `-mavx`)
+using Lanes = float __attribute__((vector_size(32)));
+
+constexpr size_t kLanes = sizeof(Lanes) / sizeof(float);
+
+// `kAligned` selects the load: a plain dereference assumes 32-byte alignment
+template <bool kAligned>
+float Sum(const float* data, size_t size) {
+    Lanes acc = {};
+    for (size_t i = 0; i + kLanes <= size; i += kLanes) {
+        Lanes chunk;
+        if constexpr (kAligned) {
+            chunk = *reinterpret_cast<const Lanes*>(data + i);
+        } else {
+            std::memcpy(&chunk, data + i, sizeof(chunk));
+        }
+        acc += chunk;
+    }
+    float result = 0;
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+        result += acc[lane];
+    }
+    return result;
+}
+
+void BM_SumDefault(benchmark::State& state) {
+    size_t size = state.range(0);
+    auto data = MakeUnique<float[]>(size);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Sum<false>(data.Get(), size));
+    }
+    state.SetBytesProcessed(state.iterations() * size * sizeof(float));
+}
+
+// Shifted by one element, so every other load splits a cache line
+void BM_SumMisaligned(benchmark::State& state) {
+    size_t size = state.range(0);
+    auto data = MakeUniqueAligned<float[]>(size + 1, 64);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Sum<false>(data.Get() + 1, size));
+    }
+    state.SetBytesProcessed(state.iterations() * size * sizeof(float));
+}
+
+void BM_SumAligned(benchmark::State& state) {
+    size_t size = state.range(0);
+    auto data = MakeUniqueAligned<float[]>(size, 64);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Sum<true>(data.Get(), size));
+    }
+    state.SetBytesProcessed(state.iterations() * size * sizeof(float));
+}
+
+void BM_SumAlignedHugePages(benchmark::State& state) {
+    size_t size = state.range(0);
+    auto data = MakeUniqueAligned<float[]>(size, 64, HugePages::kAdvise);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Sum<true>(data.Get(), size));
+    }
+    state.SetBytesProcessed(state.iterations() * size * sizeof(float));
+}
+
+// From L1-resident to well beyond the last level cache
+BENCHMARK(BM_SumDefault)->RangeMultiplier(64)->Range(1 << 10, 1 << 22);
+BENCHMARK(BM_SumMisaligned)->RangeMultiplier(64)->Range(1 << 10, 1 << 22);
+BENCHMARK(BM_SumAligned)->RangeMultiplier(64)->Range(1 << 10, 1 << 22);
+BENCHMARK(BM_SumAlignedHugePages)->Arg(1 << 22);
+
+}  // namespace
@@ -0,0 +1,198 @@
+#include "adapters.h"
+#include "slab.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Bump allocator over a fixed buffer, `deallocate` is a no-op
+
+class Arena {
+public:
+    explicit Arena(size_t size) : buffer_(new std::byte[size]), size_(size) {
+    }
+
+    void* Allocate(size_t bytes, size_t alignment) {
+        size_t offset = (used_ + alignment - 1) / alignment * alignment;
+        if (offset + bytes > size_) {
+            throw std::bad_alloc();
+        }
+        used_ = offset + bytes;
+        return buffer_.get() + offset;
+    }
+
+    void Clear() {
+        used_ = 0;
+    }
+
+private:
+    std::unique_ptr<std::byte[]> buffer_;
+    size_t size_;
+    size_t used_ = 0;
+};
+
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena* arena) : arena(arena) {
+    }
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {
+    }
+
+    T* allocate(size_t size) {
+        return static_cast<T*>(arena->Allocate(size * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) {
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return arena == other.arena;
+    }
+
+    Arena* arena;
+};
+
+constexpr size_t kBatch = 1024;
+
+void BM_MakeSharedBatch(benchmark::State& state) {
+    std::vector<SharedPtr<Payload>> ptrs(kBatch);
+    for (auto _ : state) {
+        for (auto& ptr : ptrs) {
+            ptr = MakeShared<Payload>();
+        }
+        for (auto& ptr : ptrs) {
+            ptr.Reset();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+}
+
+template <typename Policy>
+void BM_AllocateSharedArenaBatch(benchmark::State& state) {
+    Arena arena(kBatch * 64);
+    ArenaAllocator<Payload> alloc(&arena);
+    std::vector<SharedPtr<Payload, Policy>> ptrs(kBatch);
+    for (auto _ : state) {
+        for (auto& ptr : ptrs) {
+            ptr = AllocateShared<Payload, Policy>(alloc);
+        }
+        for (auto& ptr : ptrs) {
+            ptr.Reset();
+        }
+        arena.Clear();
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+}
+
+void BM_StdAllocateSharedArenaBatch(benchmark::State& state) {
+    Arena arena(kBatch * 64);
+    ArenaAllocator<Payload> alloc(&arena);
+    std::vector<std::shared_ptr<Payload>> ptrs(kBatch);
+    for (auto _ : state) {
+        for (auto& ptr : ptrs) {
+            ptr = std::allocate_shared<Payload>(alloc);
+        }
+        for (auto& ptr : ptrs) {
+            ptr.reset();
+        }
+        arena.Clear();
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+}
+
+BENCHMARK(BM_MakeSharedBatch);
+// `std::shared_ptr` checks both counts with one load and releases a block with no weak
+// references without atomic updates. `PackedSharedPolicy` can do the same, the separate
+// counts of `DefaultSharedPolicy` still take one atomic decrement of the strong count.
+BENCHMARK_TEMPLATE(BM_AllocateSharedArenaBatch, DefaultSharedPolicy);
+BENCHMARK_TEMPLATE(BM_AllocateSharedArenaBatch, PackedSharedPolicy);
+BENCHMARK(BM_StdAllocateSharedArenaBatch);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Blocks of `SharedPtr(new T)`: the global heap vs `SlabPool`
+
+template <typename Policy>
+void BM_SeparateBlock(benchmark::State& state) {
+    for (auto _ : state) {
+        SharedPtr<Payload, Policy> ptr(new Payload);
+        benchmark::DoNotOptimize(ptr);
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_SeparateBlock, DefaultSharedPolicy);
+BENCHMARK_TEMPLATE(BM_SeparateBlock, SlabBlocks<DefaultSharedPolicy>);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Large payloads: zeroing vs leaving them for the caller
+
+template <size_t kSize>
+struct Buffer {
+    char data[kSize];
+};
+
+template <size_t kSize>
+void BM_MakeSharedBuffer(benchmark::State& state) {
+    for (auto _ : state) {
+        auto ptr = MakeShared<Buffer<kSize>>();
+        benchmark::DoNotOptimize(ptr->data);
+    }
+    state.SetBytesProcessed(state.iterations() * kSize);
+}
+
+template <size_t kSize>
+void BM_MakeSharedForOverwriteBuffer(benchmark::State& state) {
+    for (auto _ : state) {
+        auto ptr = MakeSharedForOverwrite<Buffer<kSize>>();
+        benchmark::DoNotOptimize(ptr->data);
+    }
+    state.SetBytesProcessed(state.iterations() * kSize);
+}
+
+void BM_MakeSharedArray(benchmark::State& state) {
+    size_t size = state.range(0);
+    for (auto _ : state) {
+        auto ptr = MakeShared<char[]>(size);
+        benchmark::DoNotOptimize(ptr.Get());
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+
+void BM_MakeSharedForOverwriteArray(benchmark::State& state) {
+    size_t size = state.range(0);
+    for (auto _ : state) {
+        auto ptr = MakeSharedForOverwrite<char[]>(size);
+        benchmark::DoNotOptimize(ptr.Get());
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+
+// Two allocations: the array and the block
+void BM_SharedArrayFromNew(benchmark::State& state) {
+    size_t size = state.range(0);
+    for (auto _ : state) {
+        SharedPtr<char[]> ptr(new char[size]());
+        benchmark::DoNotOptimize(ptr.Get());
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+
+BENCHMARK_TEMPLATE(BM_MakeSharedBuffer, 4096);
+BENCHMARK_TEMPLATE(BM_MakeSharedForOverwriteBuffer, 4096);
+BENCHMARK_TEMPLATE(BM_MakeSharedBuffer, 1 << 20);
+BENCHMARK_TEMPLATE(BM_MakeSharedForOverwriteBuffer, 1 << 20);
+BENCHMARK(BM_MakeSharedArray)->RangeMultiplier(16)->Range(64, 1 << 20);
+BENCHMARK(BM_MakeSharedForOverwriteArray)->RangeMultiplier(16)->Range(64, 1 << 20);
+BENCHMARK(BM_SharedArrayFromNew)->RangeMultiplier(16)->Range(64, 1 << 20);
+
+}  // namespace
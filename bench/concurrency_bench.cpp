@@ -0,0 +1,93 @@
+#include "adapters.h"
+#include "atomic_shared.h"
+
+#include <benchmark/benchmark.h>
+
+#include <mutex>
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Readers of a shared slot: `AtomicSharedPtr` vs a mutex-guarded `SharedPtr`
+
+class MutexSharedPtr {
+public:
+    explicit MutexSharedPtr(SharedPtr<Payload> value) : value_(std::move(value)) {
+    }
+
+    SharedPtr<Payload> Load() const {
+        std::lock_guard lock(mutex_);
+        return value_;
+    }
+
+    void Store(SharedPtr<Payload> value) {
+        std::lock_guard lock(mutex_);
+        value_.Swap(value);
+    }
+
+private:
+    mutable std::mutex mutex_;
+    SharedPtr<Payload> value_;
+};
+
+AtomicSharedPtr<Payload> atomic_slot(MakeShared<Payload>());
+MutexSharedPtr mutex_slot(MakeShared<Payload>());
+
+template <typename Slot>
+void BM_SlotLoad(benchmark::State& state, Slot* slot) {
+    for (auto _ : state) {
+        auto value = slot->Load();
+        benchmark::DoNotOptimize(value->value);
+    }
+}
+
+// Thread 0 keeps replacing the value while the others read it
+template <typename Slot>
+void BM_SlotLoadWithWriter(benchmark::State& state, Slot* slot) {
+    for (auto _ : state) {
+        if (state.thread_index() == 0) {
+            slot->Store(MakeShared<Payload>());
+        } else {
+            auto value = slot->Load();
+            benchmark::DoNotOptimize(value->value);
+        }
+    }
+}
+
+BENCHMARK_CAPTURE(BM_SlotLoad, Atomic, &atomic_slot)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_CAPTURE(BM_SlotLoad, Mutex, &mutex_slot)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_CAPTURE(BM_SlotLoadWithWriter, Atomic, &atomic_slot)->ThreadRange(2, 8)->UseRealTime();
+BENCHMARK_CAPTURE(BM_SlotLoadWithWriter, Mutex, &mutex_slot)->ThreadRange(2, 8)->UseRealTime();
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Every thread copies its own object; unpadded counters of neighbours share cache lines
+
+// Nodes live in a static array
+struct NoDelete {
+    template <typename T>
+    static void Destroy(T*) {
+    }
+};
+
+struct UnpaddedNode : ThreadSafeRefCounted<UnpaddedNode, NoDelete> {
+};
+
+struct PaddedNode : PaddedThreadSafeRefCounted<PaddedNode, NoDelete> {
+};
+
+template <typename Node>
+void BM_NeighbourCopy(benchmark::State& state) {
+    static Node nodes[64];
+    IntrusivePtr<Node> source(&nodes[state.thread_index()]);
+    for (auto _ : state) {
+        auto copy = source;
+        benchmark::DoNotOptimize(copy);
+    }
+    state.counters["node_bytes"] =
+        benchmark::Counter(sizeof(Node), benchmark::Counter::kAvgThreads);
+}
+
+BENCHMARK_TEMPLATE(BM_NeighbourCopy, UnpaddedNode)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_NeighbourCopy, PaddedNode)->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,225 @@
+#include "adapters.h"
+#include "intrusive_weak.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr size_t kBatch = 1024;
+
+template <typename Impl>
+void BM_SharedConstruct(benchmark::State& state) {
+    for (auto _ : state) {
+        typename Impl::template Shared<Payload> ptr(new Payload);
+        benchmark::DoNotOptimize(ptr);
+    }
+}
+
+template <typename Impl>
+void BM_SharedMake(benchmark::State& state) {
+    for (auto _ : state) {
+        auto ptr = Impl::template Make<Payload>();
+        benchmark::DoNotOptimize(ptr);
+    }
+}
+
+template <typename Impl>
+void BM_SharedCopy(benchmark::State& state) {
+    auto source = Impl::template Make<Payload>();
+    for (auto _ : state) {
+        auto copy = source;
+        benchmark::DoNotOptimize(copy);
+    }
+}
+
+template <typename Impl>
+void BM_SharedMove(benchmark::State& state) {
+    auto ptr = Impl::template Make<Payload>();
+    for (auto _ : state) {
+        auto moved = std::move(ptr);
+        benchmark::DoNotOptimize(moved);
+        ptr = std::move(moved);
+    }
+}
+
+template <typename Impl>
+void BM_SharedAssign(benchmark::State& state) {
+    auto first = Impl::template Make<Payload>();
+    auto second = Impl::template Make<Payload>();
+    auto target = first;
+    for (auto _ : state) {
+        target = second;
+        benchmark::DoNotOptimize(target);
+        target = first;
+        benchmark::DoNotOptimize(target);
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+
+template <typename Impl>
+void BM_WeakLock(benchmark::State& state) {
+    auto source = Impl::template Make<Payload>();
+    typename Impl::template Weak<Payload> weak(source);
+    for (auto _ : state) {
+        auto locked = Impl::Lock(weak);
+        benchmark::DoNotOptimize(locked);
+    }
+}
+
+template <typename Impl>
+void BM_WeakLockExpired(benchmark::State& state) {
+    auto source = Impl::template Make<Payload>();
+    typename Impl::template Weak<Payload> weak(source);
+    Impl::Reset(source);
+    for (auto _ : state) {
+        auto locked = Impl::Lock(weak);
+        benchmark::DoNotOptimize(locked);
+    }
+}
+
+// Dropping the last of `kBatch` copies, the object and the block stay alive
+template <typename Impl>
+void BM_SharedDestroy(benchmark::State& state) {
+    auto source = Impl::template Make<Payload>();
+    std::vector<typename Impl::template Shared<Payload>> copies(kBatch);
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::fill(copies.begin(), copies.end(), source);
+        state.ResumeTiming();
+        for (auto& copy : copies) {
+            Impl::Reset(copy);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+}
+
+// Dropping the only owner, the object and the block are freed
+template <typename Impl>
+void BM_SharedDestroyLast(benchmark::State& state) {
+    std::vector<typename Impl::template Shared<Payload>> owners(kBatch);
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (auto& owner : owners) {
+            owner = Impl::template Make<Payload>();
+        }
+        state.ResumeTiming();
+        for (auto& owner : owners) {
+            Impl::Reset(owner);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+}
+
+BENCHMARK_TEMPLATE(BM_SharedConstruct, Ours<>);
+BENCHMARK_TEMPLATE(BM_SharedConstruct, Std);
+BENCHMARK_TEMPLATE(BM_SharedMake, Ours<>);
+BENCHMARK_TEMPLATE(BM_SharedMake, Std);
+BENCHMARK_TEMPLATE(BM_SharedCopy, Ours<>);
+BENCHMARK_TEMPLATE(BM_SharedCopy, Std);
+BENCHMARK_TEMPLATE(BM_SharedMove, Ours<>);
+BENCHMARK_TEMPLATE(BM_SharedMove, Std);
+BENCHMARK_TEMPLATE(BM_SharedAssign, Ours<>);
+BENCHMARK_TEMPLATE(BM_SharedAssign, Std);
+BENCHMARK_TEMPLATE(BM_WeakLock, Ours<>);
+BENCHMARK_TEMPLATE(BM_WeakLock, Std);
+BENCHMARK_TEMPLATE(BM_WeakLockExpired, Ours<>);
+BENCHMARK_TEMPLATE(BM_WeakLockExpired, Std);
+BENCHMARK_TEMPLATE(BM_SharedDestroy, Ours<>);
+BENCHMARK_TEMPLATE(BM_SharedDestroy, Std);
+BENCHMARK_TEMPLATE(BM_SharedDestroyLast, Ours<>);
+BENCHMARK_TEMPLATE(BM_SharedDestroyLast, Std);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// UniquePtr
+
+struct StatefulDelete {
+    void operator()(Payload* ptr) const {
+        delete ptr;
+    }
+
+    int tag = 0;
+};
+
+template <typename Ptr>
+void BM_UniqueConstructDestroy(benchmark::State& state) {
+    for (auto _ : state) {
+        Ptr ptr(new Payload);
+        benchmark::DoNotOptimize(ptr);
+    }
+    state.counters["bytes"] = sizeof(Ptr);
+}
+
+template <typename Ptr>
+void BM_UniqueMove(benchmark::State& state) {
+    Ptr ptr(new Payload);
+    for (auto _ : state) {
+        Ptr moved(std::move(ptr));
+        benchmark::DoNotOptimize(moved);
+        ptr = std::move(moved);
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_UniqueConstructDestroy, UniquePtr<Payload>);
+BENCHMARK_TEMPLATE(BM_UniqueConstructDestroy, std::unique_ptr<Payload>);
+BENCHMARK_TEMPLATE(BM_UniqueConstructDestroy, UniquePtr<Payload, StatefulDelete>);
+BENCHMARK_TEMPLATE(BM_UniqueConstructDestroy, std::unique_ptr<Payload, StatefulDelete>);
+BENCHMARK_TEMPLATE(BM_UniqueMove, UniquePtr<Payload>);
+BENCHMARK_TEMPLATE(BM_UniqueMove, std::unique_ptr<Payload>);
+BENCHMARK_TEMPLATE(BM_UniqueMove, UniquePtr<Payload, StatefulDelete>);
+BENCHMARK_TEMPLATE(BM_UniqueMove, std::unique_ptr<Payload, StatefulDelete>);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// IntrusivePtr
+
+struct SimpleNode : SimpleRefCounted<SimpleNode> {
+    int value = 0;
+};
+
+struct ThreadSafeNode : ThreadSafeRefCounted<ThreadSafeNode> {
+    int value = 0;
+};
+
+// Pays one pointer until weakly referenced
+struct WeakThreadSafeNode : ThreadSafeWeakRefCounted<WeakThreadSafeNode> {
+    int value = 0;
+};
+
+template <typename Node>
+void BM_IntrusiveMake(benchmark::State& state) {
+    for (auto _ : state) {
+        auto ptr = MakeIntrusive<Node>();
+        benchmark::DoNotOptimize(ptr);
+    }
+}
+
+template <typename Node>
+void BM_IntrusiveCopy(benchmark::State& state) {
+    auto source = MakeIntrusive<Node>();
+    for (auto _ : state) {
+        auto copy = source;
+        benchmark::DoNotOptimize(copy);
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_IntrusiveMake, SimpleNode);
+BENCHMARK_TEMPLATE(BM_IntrusiveMake, ThreadSafeNode);
+BENCHMARK_TEMPLATE(BM_IntrusiveCopy, SimpleNode);
+BENCHMARK_TEMPLATE(BM_IntrusiveCopy, ThreadSafeNode);
+
+template <typename Node>
+void BM_IntrusiveWeakLock(benchmark::State& state) {
+    auto source = MakeIntrusive<Node>();
+    WeakIntrusivePtr<Node> weak(source);
+    for (auto _ : state) {
+        auto locked = weak.Lock();
+        benchmark::DoNotOptimize(locked);
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_IntrusiveMake, WeakThreadSafeNode);
+BENCHMARK_TEMPLATE(BM_IntrusiveWeakLock, WeakThreadSafeNode);
+
+}  // namespace
@@ -0,0 +1,684 @@
+#include "affine.h"
+#include "deferred.h"
+#include "intrusive.h"
+#include "shared.h"
+#include "tagged.h"
+#include "unique.h"
+#include "weak.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <list>
+#include <malloc.h>
+#include <mutex>
+#include <new>
+#include <random>
+#include <sys/resource.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Workloads shaped like real pointer-heavy structures. Besides time, every case reports
+//   allocs:     heap allocations per iteration
+//   peak_heap:  maximum of live heap bytes during the case
+//   peak_rss:   maximum resident set size of the process so far
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Heap accounting: the global allocation functions of this binary are replaced
+
+namespace {
+
+struct HeapStats {
+    std::atomic<size_t> allocations = 0;
+    std::atomic<size_t> live = 0;
+    std::atomic<size_t> peak = 0;
+};
+
+HeapStats heap_stats;
+
+void* Track(void* ptr) {
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    heap_stats.allocations.fetch_add(1, std::memory_order_relaxed);
+    size_t live = heap_stats.live.fetch_add(malloc_usable_size(ptr), std::memory_order_relaxed) +
+                  malloc_usable_size(ptr);
+    size_t peak = heap_stats.peak.load(std::memory_order_relaxed);
+    while (live > peak &&
+           !heap_stats.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+    return ptr;
+}
+
+void Untrack(void* ptr) {
+    if (ptr) {
+        heap_stats.live.fetch_sub(malloc_usable_size(ptr), std::memory_order_relaxed);
+        std::free(ptr);
+    }
+}
+
+// Resets the statistics on creation, reports them to `state` on `Report`
+class HeapScope {
+public:
+    HeapScope() {
+        heap_stats.peak.store(heap_stats.live.load(std::memory_order_relaxed),
+                              std::memory_order_relaxed);
+        start_allocations_ = heap_stats.allocations.load(std::memory_order_relaxed);
+        start_live_ = heap_stats.live.load(std::memory_order_relaxed);
+    }
+
+    void Report(benchmark::State& state) const {
+        size_t allocations =
+            heap_stats.allocations.load(std::memory_order_relaxed) - start_allocations_;
+        state.counters["allocs"] =
+            benchmark::Counter(allocations, benchmark::Counter::kAvgIterations);
+        state.counters["peak_heap"] = benchmark::Counter(
+            heap_stats.peak.load(std::memory_order_relaxed) - start_live_,
+            benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        state.counters["peak_rss"] = benchmark::Counter(
+            usage.ru_maxrss * 1024.0, benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+    }
+
+private:
+    size_t start_allocations_;
+    size_t start_live_;
+};
+
+}  // namespace
+
+void* operator new(size_t size) {
+    return Track(std::malloc(size == 0 ? 1 : size));
+}
+
+void* operator new[](size_t size) {
+    return Track(std::malloc(size == 0 ? 1 : size));
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+    size_t alignment = static_cast<size_t>(align);
+    return Track(std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t align) {
+    return operator new(size, align);
+}
+
+void operator delete(void* ptr) noexcept {
+    Untrack(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    Untrack(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    Untrack(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    Untrack(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    Untrack(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    Untrack(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+    Untrack(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+    Untrack(ptr);
+}
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Scene graph: children are owned, parents are weak. Build a tree, compute world positions
+// of the leaves by walking up the parent links, then drop the root.
+
+struct SceneNode {
+    float offset[3] = {1, 2, 3};
+    WeakPtr<SceneNode> parent;
+    std::vector<SharedPtr<SceneNode>> children;
+};
+
+size_t BuildScene(const SharedPtr<SceneNode>& node, int depth, int fanout,
+                  std::vector<SharedPtr<SceneNode>>* leaves) {
+    if (depth == 0) {
+        leaves->push_back(node);
+        return 1;
+    }
+    size_t count = 1;
+    node->children.reserve(fanout);
+    for (int i = 0; i < fanout; ++i) {
+        auto child = MakeShared<SceneNode>();
+        child->parent = WeakPtr<SceneNode>(node);
+        count += BuildScene(child, depth - 1, fanout, leaves);
+        node->children.push_back(std::move(child));
+    }
+    return count;
+}
+
+void BM_SceneGraph(benchmark::State& state) {
+    int depth = state.range(0);
+    int fanout = state.range(1);
+    HeapScope heap;
+    size_t nodes = 0;
+    for (auto _ : state) {
+        auto root = MakeShared<SceneNode>();
+        std::vector<SharedPtr<SceneNode>> leaves;
+        nodes = BuildScene(root, depth, fanout, &leaves);
+        float sum = 0;
+        for (const auto& leaf : leaves) {
+            for (auto node = leaf; node; node = node->parent.Lock()) {
+                sum += node->offset[0] + node->offset[1] + node->offset[2];
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+        leaves.clear();
+        root.Reset();
+    }
+    state.SetItemsProcessed(state.iterations() * nodes);
+    heap.Report(state);
+}
+
+BENCHMARK(BM_SceneGraph)->Args({4, 8})->Args({6, 6})->Unit(benchmark::kMillisecond);
+
+// Only the drop of the last reference to a tree is timed: the whole destructor cascade
+// inline, or a hand-off to the background reclaimer
+template <typename Policy>
+struct TreeNode {
+    std::vector<SharedPtr<TreeNode, Policy>> children;
+};
+
+template <typename Policy>
+SharedPtr<TreeNode<Policy>, Policy> BuildTree(int depth, int fanout) {
+    auto node = MakeShared<TreeNode<Policy>, Policy>();
+    for (int i = 0; depth > 0 && i < fanout; ++i) {
+        node->children.push_back(BuildTree<Policy>(depth - 1, fanout));
+    }
+    return node;
+}
+
+template <typename Policy>
+void BM_DropTree(benchmark::State& state) {
+    DeferredReclaimer::Global().Start();
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto root = BuildTree<Policy>(state.range(0), state.range(1));
+        state.ResumeTiming();
+        root.Reset();
+    }
+    DeferredReclaimer::Global().Stop();
+}
+
+BENCHMARK_TEMPLATE(BM_DropTree, DefaultSharedPolicy)->Args({5, 6});
+BENCHMARK_TEMPLATE(BM_DropTree, DeferredDestruction<DefaultSharedPolicy>)->Args({5, 6});
+
+// Dropping the head of a linked list: a recursive cascade or a loop over queued nodes
+template <typename Policy>
+struct ChainNode {
+    SharedPtr<ChainNode, Policy> next;
+};
+
+template <typename Policy>
+void BM_DropChain(benchmark::State& state) {
+    HeapScope heap;
+    for (auto _ : state) {
+        state.PauseTiming();
+        SharedPtr<ChainNode<Policy>, Policy> head;
+        for (int64_t i = 0; i < state.range(0); ++i) {
+            auto node = MakeShared<ChainNode<Policy>, Policy>();
+            node->next = std::move(head);
+            head = std::move(node);
+        }
+        state.ResumeTiming();
+        head.Reset();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    heap.Report(state);
+}
+
+// Longer chains overflow the stack without iterative teardown
+BENCHMARK_TEMPLATE(BM_DropChain, DefaultSharedPolicy)->Arg(1 << 14);
+BENCHMARK_TEMPLATE(BM_DropChain, IterativeDestruction<DefaultSharedPolicy>)->Arg(1 << 14);
+BENCHMARK_TEMPLATE(BM_DropChain, IterativeDestruction<DefaultSharedPolicy>)->Arg(1 << 20);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// LRU cache handing out shared values: evicted values stay alive while readers hold them
+
+struct CacheValue {
+    uint64_t key;
+    char data[240];
+};
+
+class LruCache {
+public:
+    explicit LruCache(size_t capacity) : capacity_(capacity) {
+        index_.reserve(capacity * 2);
+    }
+
+    SharedPtr<CacheValue> Get(uint64_t key, bool* hit) {
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            *hit = true;
+            order_.splice(order_.begin(), order_, it->second);
+            return it->second->second;
+        }
+        *hit = false;
+        auto value = MakeSharedForOverwrite<CacheValue>();
+        value->key = key;
+        if (index_.size() == capacity_) {
+            index_.erase(order_.back().first);
+            order_.pop_back();
+        }
+        order_.emplace_front(key, value);
+        index_.emplace(key, order_.begin());
+        return value;
+    }
+
+private:
+    using Entry = std::pair<uint64_t, SharedPtr<CacheValue>>;
+
+    size_t capacity_;
+    std::list<Entry> order_;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+};
+
+void BM_LruCache(benchmark::State& state) {
+    size_t capacity = state.range(0);
+    constexpr size_t kLookups = 1 << 16;
+    // Skewed keys: half of the lookups go to a hot set of a quarter of the capacity
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<uint64_t> cold(0, capacity * 4);
+    std::uniform_int_distribution<uint64_t> hot(0, capacity / 4);
+    std::vector<uint64_t> keys(kLookups);
+    for (auto& key : keys) {
+        key = random() % 2 ? hot(random) : cold(random);
+    }
+
+    HeapScope heap;
+    size_t hits = 0;
+    for (auto _ : state) {
+        LruCache cache(capacity);
+        // Readers keep a window of recent values, some of them already evicted
+        std::deque<SharedPtr<CacheValue>> readers;
+        for (uint64_t key : keys) {
+            bool hit;
+            readers.push_back(cache.Get(key, &hit));
+            hits += hit;
+            if (readers.size() > 64) {
+                readers.pop_front();
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kLookups);
+    state.counters["hit_rate"] =
+        static_cast<double>(hits) / static_cast<double>(state.iterations() * kLookups);
+    heap.Report(state);
+}
+
+BENCHMARK(BM_LruCache)->Arg(1 << 10)->Arg(1 << 14)->Unit(benchmark::kMillisecond);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// DAG of immutable nodes, each sharing a few nodes built shortly before it
+
+struct SharedDag {
+    struct Node {
+        uint64_t value = 1;
+        std::vector<SharedPtr<const Node>> inputs;
+    };
+
+    using Ptr = SharedPtr<const Node>;
+
+    static SharedPtr<Node> Make() {
+        return MakeShared<Node>();
+    }
+};
+
+struct IntrusiveDag {
+    struct Node : ThreadSafeRefCounted<Node> {
+        uint64_t value = 1;
+        std::vector<IntrusivePtr<Node>> inputs;
+    };
+
+    using Ptr = IntrusivePtr<Node>;
+
+    static IntrusivePtr<Node> Make() {
+        return MakeIntrusive<Node>();
+    }
+};
+
+template <typename Dag>
+void BM_Dag(benchmark::State& state) {
+    size_t size = state.range(0);
+    constexpr size_t kWindow = 64;
+    constexpr size_t kFanIn = 3;
+    std::mt19937_64 random(42);
+
+    HeapScope heap;
+    for (auto _ : state) {
+        std::vector<typename Dag::Ptr> nodes;
+        nodes.reserve(size);
+        for (size_t i = 0; i < size; ++i) {
+            auto node = Dag::Make();
+            size_t first = i > kWindow ? i - kWindow : 0;
+            for (size_t j = 0; j < kFanIn && i > 0; ++j) {
+                const auto& input = nodes[first + random() % (i - first)];
+                node->value += input->value;
+                node->inputs.push_back(input);
+            }
+            nodes.push_back(std::move(node));
+        }
+        // Walks from the sinks towards the sources
+        uint64_t sum = 0;
+        for (size_t walk = 0; walk < kWindow; ++walk) {
+            const auto* node = nodes[size - 1 - walk].Get();
+            while (!node->inputs.empty()) {
+                sum += node->value;
+                node = node->inputs[random() % node->inputs.size()].Get();
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+        // Newest first: dropping a node never cascades into a deep chain of releases
+        while (!nodes.empty()) {
+            nodes.pop_back();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+    heap.Report(state);
+}
+
+BENCHMARK_TEMPLATE(BM_Dag, SharedDag)->Arg(1 << 16)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Dag, IntrusiveDag)->Arg(1 << 16)->Unit(benchmark::kMillisecond);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Graph with a small edge kind on every edge: kept next to the pointer or in its spare bits
+
+template <typename Ptr>
+struct KindedEdge {
+    Ptr target;
+    uint8_t kind;
+};
+
+struct SharedGraph {
+    struct Node {
+        uint64_t value = 1;
+        std::vector<KindedEdge<SharedPtr<Node>>> edges;
+    };
+
+    using Ptr = SharedPtr<Node>;
+    using Edge = KindedEdge<Ptr>;
+
+    static Ptr Make() {
+        return MakeShared<Node>();
+    }
+
+    static Edge MakeEdge(const Ptr& target, uint8_t kind) {
+        return Edge{target, kind};
+    }
+
+    static uintptr_t GetKind(const Edge& edge) {
+        return edge.kind;
+    }
+
+    static const Node* GetTarget(const Edge& edge) {
+        return edge.target.Get();
+    }
+};
+
+struct TaggedSharedGraph {
+    struct Node {
+        uint64_t value = 1;
+        std::vector<TaggedSharedPtr<Node>> edges;
+    };
+
+    using Ptr = SharedPtr<Node>;
+    using Edge = TaggedSharedPtr<Node>;
+
+    static Ptr Make() {
+        return MakeShared<Node>();
+    }
+
+    static Edge MakeEdge(const Ptr& target, uint8_t kind) {
+        return Edge(target, kind);
+    }
+
+    static uintptr_t GetKind(const Edge& edge) {
+        return edge.GetTag();
+    }
+
+    static const Node* GetTarget(const Edge& edge) {
+        return edge.Get();
+    }
+};
+
+struct IntrusiveGraph {
+    struct Node : ThreadSafeRefCounted<Node> {
+        uint64_t value = 1;
+        std::vector<KindedEdge<IntrusivePtr<Node>>> edges;
+    };
+
+    using Ptr = IntrusivePtr<Node>;
+    using Edge = KindedEdge<Ptr>;
+
+    static Ptr Make() {
+        return MakeIntrusive<Node>();
+    }
+
+    static Edge MakeEdge(const Ptr& target, uint8_t kind) {
+        return Edge{target, kind};
+    }
+
+    static uintptr_t GetKind(const Edge& edge) {
+        return edge.kind;
+    }
+
+    static const Node* GetTarget(const Edge& edge) {
+        return edge.target.Get();
+    }
+};
+
+struct TaggedIntrusiveGraph {
+    struct Node : ThreadSafeRefCounted<Node> {
+        uint64_t value = 1;
+        std::vector<TaggedIntrusivePtr<Node>> edges;
+    };
+
+    using Ptr = IntrusivePtr<Node>;
+    using Edge = TaggedIntrusivePtr<Node>;
+
+    static Ptr Make() {
+        return MakeIntrusive<Node>();
+    }
+
+    static Edge MakeEdge(const Ptr& target, uint8_t kind) {
+        return Edge(target, kind);
+    }
+
+    static uintptr_t GetKind(const Edge& edge) {
+        return edge.GetTag();
+    }
+
+    static const Node* GetTarget(const Edge& edge) {
+        return edge.Get();
+    }
+};
+
+// Reports `edge_bytes`, the size of one edge, next to the heap counters
+template <typename Graph>
+void BM_TaggedGraph(benchmark::State& state) {
+    size_t size = state.range(0);
+    constexpr size_t kWindow = 256;
+    constexpr size_t kDegree = 8;
+    constexpr uint8_t kKinds = 4;
+    std::mt19937_64 random(42);
+
+    HeapScope heap;
+    for (auto _ : state) {
+        std::vector<typename Graph::Ptr> nodes;
+        nodes.reserve(size);
+        for (size_t i = 0; i < size; ++i) {
+            auto node = Graph::Make();
+            size_t first = i > kWindow ? i - kWindow : 0;
+            node->edges.reserve(i > 0 ? kDegree : 0);
+            for (size_t j = 0; j < kDegree && i > 0; ++j) {
+                const auto& target = nodes[first + random() % (i - first)];
+                node->edges.push_back(Graph::MakeEdge(target, random() % kKinds));
+            }
+            nodes.push_back(std::move(node));
+        }
+        // Follows edges of one kind only
+        uint64_t sum = 0;
+        for (const auto& node : nodes) {
+            for (const auto& edge : node->edges) {
+                if (Graph::GetKind(edge) == 1) {
+                    sum += Graph::GetTarget(edge)->value;
+                }
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+        while (!nodes.empty()) {
+            nodes.pop_back();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+    state.counters["edge_bytes"] = sizeof(typename Graph::Edge);
+    heap.Report(state);
+}
+
+BENCHMARK_TEMPLATE(BM_TaggedGraph, SharedGraph)->Arg(1 << 18)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_TaggedGraph, TaggedSharedGraph)->Arg(1 << 18)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_TaggedGraph, IntrusiveGraph)->Arg(1 << 18)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_TaggedGraph, TaggedIntrusiveGraph)
+    ->Arg(1 << 18)
+    ->Unit(benchmark::kMillisecond);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Pipeline of three threads passing message ownership through bounded queues
+
+struct Message {
+    uint64_t id;
+    uint64_t checksum = 0;
+    char payload[496];
+};
+
+template <typename Pointer>
+class BoundedQueue {
+public:
+    void Push(Pointer message) {
+        std::unique_lock lock(mutex_);
+        not_full_.wait(lock, [this] { return queue_.size() < kCapacity; });
+        queue_.push_back(std::move(message));
+        not_empty_.notify_one();
+    }
+
+    Pointer Pop() {
+        std::unique_lock lock(mutex_);
+        not_empty_.wait(lock, [this] { return !queue_.empty(); });
+        auto message = std::move(queue_.front());
+        queue_.pop_front();
+        not_full_.notify_one();
+        return message;
+    }
+
+private:
+    static constexpr size_t kCapacity = 1024;
+
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<Pointer> queue_;
+};
+
+void BM_MessagePipeline(benchmark::State& state) {
+    size_t count = state.range(0);
+    HeapScope heap;
+    for (auto _ : state) {
+        // A null message ends the stream
+        BoundedQueue<UniquePtr<Message>> raw;
+        BoundedQueue<UniquePtr<Message>> parsed;
+        std::thread parse_stage([&] {
+            while (auto message = raw.Pop()) {
+                for (char c : message->payload) {
+                    message->checksum = message->checksum * 31 + c;
+                }
+                parsed.Push(std::move(message));
+            }
+            parsed.Push(UniquePtr<Message>());
+        });
+        std::thread sink_stage([&] {
+            uint64_t total = 0;
+            while (auto message = parsed.Pop()) {
+                total += message->checksum;
+            }
+            benchmark::DoNotOptimize(total);
+        });
+        for (size_t i = 0; i < count; ++i) {
+            auto message = MakeUniqueForOverwrite<Message>();
+            message->id = i;
+            std::fill(std::begin(message->payload), std::end(message->payload), char(i));
+            raw.Push(std::move(message));
+        }
+        raw.Push(UniquePtr<Message>());
+        parse_stage.join();
+        sink_stage.join();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    heap.Report(state);
+}
+
+BENCHMARK(BM_MessagePipeline)->Arg(1 << 16)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// One thread allocates messages, another drops them: every free crosses threads,
+// unless owner-thread destruction hands the blocks back to the producer
+template <typename Policy>
+void BM_ProducerConsumer(benchmark::State& state) {
+    size_t count = state.range(0);
+    HeapScope heap;
+    for (auto _ : state) {
+        // A null message ends the stream
+        BoundedQueue<SharedPtr<Message, Policy>> queue;
+        std::thread consumer([&] {
+            uint64_t total = 0;
+            while (auto message = queue.Pop()) {
+                total += message->id;
+            }
+            benchmark::DoNotOptimize(total);
+        });
+        for (size_t i = 0; i < count; ++i) {
+            auto message = MakeShared<Message, Policy>();
+            message->id = i;
+            queue.Push(std::move(message));
+        }
+        queue.Push(SharedPtr<Message, Policy>());
+        consumer.join();
+    }
+    AffineHome::DrainCurrent();
+    state.SetItemsProcessed(state.iterations() * count);
+    heap.Report(state);
+}
+
+BENCHMARK_TEMPLATE(BM_ProducerConsumer, DefaultSharedPolicy)
+    ->Arg(1 << 16)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ProducerConsumer, OwnerThreadDestruction<DefaultSharedPolicy>)
+    ->Arg(1 << 16)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}  // namespace
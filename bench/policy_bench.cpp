@@ -0,0 +1,75 @@
+#include "adapters.h"
+#include "biased.h"
+#include "slab.h"
+
+#include <benchmark/benchmark.h>
+
+namespace {
+
+using SingleThreadedPolicy = SharedPolicy<SingleThreaded>;
+using StrongOnlyPolicy = SharedPolicy<MultiThreaded, false>;
+using SingleThreadedStrongOnlyPolicy = SharedPolicy<SingleThreaded, false>;
+
+template <typename Policy>
+void SetBlockBytes(benchmark::State& state) {
+    state.counters["block_bytes"] = sizeof(ControlBlockArgs<Payload, Policy>);
+}
+
+template <typename Policy>
+void BM_PolicyMake(benchmark::State& state) {
+    for (auto _ : state) {
+        auto ptr = MakeShared<Payload, Policy>();
+        benchmark::DoNotOptimize(ptr);
+    }
+    SetBlockBytes<Policy>(state);
+}
+
+template <typename Policy>
+void BM_PolicyCopy(benchmark::State& state) {
+    auto source = MakeShared<Payload, Policy>();
+    for (auto _ : state) {
+        auto copy = source;
+        benchmark::DoNotOptimize(copy);
+    }
+    SetBlockBytes<Policy>(state);
+}
+
+// Same as `BM_PolicyCopy`, but the block is only known by its base type
+template <typename Policy>
+void BM_PolicyCopyFromNew(benchmark::State& state) {
+    SharedPtr<Payload, Policy> source(new Payload);
+    for (auto _ : state) {
+        auto copy = source;
+        benchmark::DoNotOptimize(copy);
+    }
+}
+
+template <typename Policy>
+void BM_PolicyWeakLock(benchmark::State& state) {
+    auto source = MakeShared<Payload, Policy>();
+    WeakPtr<Payload, Policy> weak(source);
+    for (auto _ : state) {
+        auto locked = weak.Lock();
+        benchmark::DoNotOptimize(locked);
+    }
+}
+
+#define POLICY_BENCHMARK(name)                                  \
+    BENCHMARK_TEMPLATE(name, DefaultSharedPolicy);              \
+    BENCHMARK_TEMPLATE(name, SingleThreadedPolicy);             \
+    BENCHMARK_TEMPLATE(name, StrongOnlyPolicy);                 \
+    BENCHMARK_TEMPLATE(name, SingleThreadedStrongOnlyPolicy);   \
+    BENCHMARK_TEMPLATE(name, PackedSharedPolicy);               \
+    BENCHMARK_TEMPLATE(name, BiasedSharedPolicy);               \
+    BENCHMARK_TEMPLATE(name, SlabBlocks<DefaultSharedPolicy>)
+
+POLICY_BENCHMARK(BM_PolicyMake);
+POLICY_BENCHMARK(BM_PolicyCopy);
+POLICY_BENCHMARK(BM_PolicyCopyFromNew);
+
+BENCHMARK_TEMPLATE(BM_PolicyWeakLock, DefaultSharedPolicy);
+BENCHMARK_TEMPLATE(BM_PolicyWeakLock, SingleThreadedPolicy);
+BENCHMARK_TEMPLATE(BM_PolicyWeakLock, PackedSharedPolicy);
+BENCHMARK_TEMPLATE(BM_PolicyWeakLock, BiasedSharedPolicy);
+
+}  // namespace
@@ -0,0 +1,152 @@
+#include "adapters.h"
+#include "relocate.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <vector>
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Growing containers of pointers: elements move to the new buffer with a move per element
+// (`std::vector`, noexcept moves), a copy per element (`std::vector`, moves that may throw),
+// or one `memcpy` (`RelocateN` on trivially relocatable pointers)
+
+// Moves that may throw: `std::vector` copies elements on growth to keep its guarantees
+template <typename Ptr>
+struct ThrowingMove {
+    ThrowingMove(const Ptr& value) : ptr(value) {
+    }
+
+    ThrowingMove(const ThrowingMove&) = default;
+
+    ThrowingMove(ThrowingMove&& other) noexcept(false) : ptr(std::move(other.ptr)) {
+    }
+
+    Ptr ptr;
+};
+
+// Grows by relocation, the minimum for the benchmark
+template <typename T>
+class RelocatingVector {
+public:
+    RelocatingVector() = default;
+    RelocatingVector(const RelocatingVector&) = delete;
+
+    ~RelocatingVector() {
+        std::destroy_n(data_, size_);
+        std::free(data_);
+    }
+
+    void PushBack(const T& value) {
+        if (size_ == capacity_) {
+            Grow();
+        }
+        new (data_ + size_) T(value);
+        ++size_;
+    }
+
+private:
+    void Grow() {
+        size_t capacity = std::max<size_t>(capacity_ * 2, 16);
+        auto* data = static_cast<T*>(std::malloc(capacity * sizeof(T)));
+        if (!data) {
+            throw std::bad_alloc();
+        }
+        RelocateN(data_, size_, data);
+        std::free(data_);
+        data_ = data;
+        capacity_ = capacity;
+    }
+
+    T* data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+};
+
+template <typename Ptr>
+std::vector<Ptr> MakeSources(size_t count) {
+    std::vector<Ptr> sources;
+    sources.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        sources.push_back(Ptr(new Payload{static_cast<int>(i)}));
+    }
+    return sources;
+}
+
+template <typename Ptr, typename Element>
+void BM_VectorGrowth(benchmark::State& state) {
+    auto sources = MakeSources<Ptr>(state.range(0));
+    for (auto _ : state) {
+        auto* vector = new std::vector<Element>();
+        for (const auto& source : sources) {
+            vector->push_back(source);
+        }
+        state.PauseTiming();
+        delete vector;
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <typename Ptr>
+void BM_RelocatingGrowth(benchmark::State& state) {
+    auto sources = MakeSources<Ptr>(state.range(0));
+    for (auto _ : state) {
+        auto* vector = new RelocatingVector<Ptr>();
+        for (const auto& source : sources) {
+            vector->PushBack(source);
+        }
+        state.PauseTiming();
+        delete vector;
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+using OurShared = SharedPtr<Payload>;
+using StdShared = std::shared_ptr<Payload>;
+
+#define GROWTH_BENCHMARK(...) \
+    BENCHMARK_TEMPLATE(__VA_ARGS__)->Arg(1 << 16)->Arg(10'000'000)->Unit(benchmark::kMillisecond)
+
+GROWTH_BENCHMARK(BM_VectorGrowth, OurShared, ThrowingMove<OurShared>);
+GROWTH_BENCHMARK(BM_VectorGrowth, OurShared, OurShared);
+GROWTH_BENCHMARK(BM_VectorGrowth, StdShared, StdShared);
+GROWTH_BENCHMARK(BM_RelocatingGrowth, OurShared);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sorting pointers by their pointees: every swap is three moves
+
+template <typename Impl>
+void BM_SortPointers(benchmark::State& state) {
+    using Shared = typename Impl::template Shared<Payload>;
+    std::mt19937 random(42);
+    std::vector<Shared> shuffled;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        shuffled.push_back(Impl::template Make<Payload>(Payload{static_cast<int>(random())}));
+    }
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto pointers = shuffled;
+        state.ResumeTiming();
+        std::sort(pointers.begin(), pointers.end(), [](const Shared& left, const Shared& right) {
+            return left->value < right->value;
+        });
+        benchmark::DoNotOptimize(pointers.data());
+        state.PauseTiming();
+        pointers.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_TEMPLATE(BM_SortPointers, Ours<>)->Arg(1 << 16)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_SortPointers, Std)->Arg(1 << 16)->Unit(benchmark::kMillisecond);
+
+}  // namespace
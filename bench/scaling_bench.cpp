@@ -0,0 +1,241 @@
+#include "adapters.h"
+#include "biased.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// N threads copying and dropping references. Each case runs on 1, 2, 4, ... threads up to the
+// number of available cores, every thread pinned to its own core; `items_per_second` is the
+// total number of operations per second at that core count.
+//
+// The referenced objects are placed by hand:
+//   kShared: every thread references the same object
+//   kPacked: one object per thread, neighbours share cache lines (false sharing)
+//   kPadded: one object per thread, each on its own cache lines
+
+namespace {
+
+constexpr size_t kMaxThreads = 256;
+constexpr size_t kMaxObjectSize = 256;
+
+enum class Layout {
+    kShared,
+    kPacked,
+    kPadded,
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Threads and placement
+
+std::vector<int> AllowedCpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        cpus.resize(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    return cpus;
+}
+
+// Taken before any thread is pinned
+const std::vector<int>& Cpus() {
+    static const std::vector<int> cpus = AllowedCpus();
+    return cpus;
+}
+
+void PinCurrentThread(size_t index) {
+#ifdef __linux__
+    const auto& cpus = Cpus();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[index % cpus.size()], &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+void ScaleThreads(benchmark::internal::Benchmark* benchmark) {
+    int max = static_cast<int>(std::min(Cpus().size(), kMaxThreads));
+    for (int threads = 1; threads < max; threads *= 2) {
+        benchmark->Threads(threads);
+    }
+    benchmark->Threads(max);
+    benchmark->UseRealTime();
+}
+
+alignas(kCacheLineSize) std::byte arena[kMaxThreads * kMaxObjectSize];
+
+void* Slot(size_t index, size_t size, Layout layout) {
+    switch (layout) {
+        case Layout::kShared:
+            return arena;
+        case Layout::kPacked:
+            return arena + index * size;
+        case Layout::kPadded:
+            return arena + index * ((size + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize);
+    }
+    return arena;
+}
+
+// Hands out the address it was created with, so `AllocateShared` puts the block there
+template <typename T>
+struct PlacementAllocator {
+    using value_type = T;
+
+    explicit PlacementAllocator(void* address) : address(address) {
+    }
+
+    template <typename U>
+    PlacementAllocator(const PlacementAllocator<U>& other) : address(other.address) {
+    }
+
+    T* allocate(size_t) {
+        return static_cast<T*>(address);
+    }
+
+    void deallocate(T*, size_t) {
+    }
+
+    template <typename U>
+    bool operator==(const PlacementAllocator<U>& other) const {
+        return address == other.address;
+    }
+
+    void* address;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Operations. Each one defines the referenced `Object`, its footprint `kSize`,
+// `Make(address)` and `Run(object)` for one timed operation.
+
+template <typename Policy>
+struct SharedCopy {
+    using Object = SharedPtr<Payload, Policy>;
+
+    static constexpr size_t kSize =
+        sizeof(ControlBlockAlloc<Payload, PlacementAllocator<Payload>, Policy>);
+
+    static Object Make(void* address) {
+        return AllocateShared<Payload, Policy>(PlacementAllocator<Payload>(address));
+    }
+
+    static void Run(const Object& object) {
+        Object copy(object);
+        benchmark::DoNotOptimize(copy);
+    }
+};
+
+template <typename Policy>
+struct WeakLock {
+    struct Object {
+        SharedPtr<Payload, Policy> strong;
+        WeakPtr<Payload, Policy> weak;
+    };
+
+    static constexpr size_t kSize = SharedCopy<Policy>::kSize;
+
+    static Object Make(void* address) {
+        auto strong = SharedCopy<Policy>::Make(address);
+        WeakPtr<Payload, Policy> weak(strong);
+        return Object{std::move(strong), std::move(weak)};
+    }
+
+    static void Run(const Object& object) {
+        auto locked = object.weak.Lock();
+        benchmark::DoNotOptimize(locked);
+    }
+};
+
+// Objects live in the arena: destroy them without freeing
+struct DestroyInPlace {
+    template <typename T>
+    static void Destroy(T* object) {
+        object->~T();
+    }
+};
+
+template <typename Counter>
+struct Node : RefCounted<Node<Counter>, Counter, DestroyInPlace> {
+    int value = 0;
+};
+
+template <typename Counter>
+struct IntrusiveCopy {
+    using Object = IntrusivePtr<Node<Counter>>;
+
+    static constexpr size_t kSize = sizeof(Node<Counter>);
+
+    static Object Make(void* address) {
+        return Object(new (address) Node<Counter>());
+    }
+
+    static void Run(const Object& object) {
+        Object copy(object);
+        benchmark::DoNotOptimize(copy);
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename Operation, Layout kLayout>
+void BM_Scaling(benchmark::State& state) {
+    static_assert(Operation::kSize <= kMaxObjectSize);
+    static typename Operation::Object shared;
+
+    size_t index = state.thread_index();
+    PinCurrentThread(index);
+    typename Operation::Object own;
+    if constexpr (kLayout == Layout::kShared) {
+        if (index == 0) {
+            shared = Operation::Make(arena);
+        }
+    } else {
+        own = Operation::Make(Slot(index, Operation::kSize, kLayout));
+    }
+    // Threads start the loop together, after `shared` is set
+    const auto& object = kLayout == Layout::kShared ? shared : own;
+    for (auto _ : state) {
+        Operation::Run(object);
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (kLayout == Layout::kShared && index == 0) {
+        shared = {};
+    }
+}
+
+#define SCALING_BENCHMARK(...)                                                          \
+    BENCHMARK_TEMPLATE(BM_Scaling, __VA_ARGS__, Layout::kShared)->Apply(ScaleThreads);  \
+    BENCHMARK_TEMPLATE(BM_Scaling, __VA_ARGS__, Layout::kPacked)->Apply(ScaleThreads);  \
+    BENCHMARK_TEMPLATE(BM_Scaling, __VA_ARGS__, Layout::kPadded)->Apply(ScaleThreads)
+
+SCALING_BENCHMARK(SharedCopy<DefaultSharedPolicy>);
+SCALING_BENCHMARK(SharedCopy<SharedPolicy<MultiThreaded, false>>);
+SCALING_BENCHMARK(SharedCopy<PackedSharedPolicy>);
+SCALING_BENCHMARK(SharedCopy<BiasedSharedPolicy>);
+
+SCALING_BENCHMARK(WeakLock<DefaultSharedPolicy>);
+SCALING_BENCHMARK(WeakLock<PackedSharedPolicy>);
+SCALING_BENCHMARK(WeakLock<BiasedSharedPolicy>);
+
+SCALING_BENCHMARK(IntrusiveCopy<ThreadSafeCounter>);
+SCALING_BENCHMARK(IntrusiveCopy<PaddedThreadSafeCounter>);
+
+}  // namespace
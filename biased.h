@@ -0,0 +1,206 @@
+#pragma once
+
+#include "policies.h"
+#include "return_queue.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class BiasedCounter;
+
+// Owner thread of biased counters.
+// Foreign threads that release more references than they took hand the counter back here,
+// the owner merges its biased part at its next drain point: `DrainCurrent()`, the creation of
+// another biased counter on the thread, or the thread exit.
+using BiasedOwner = ThreadReturnQueue<BiasedCounter>;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Biased reference counting: the thread that created the block updates `biased_`
+// with plain loads and stores, other threads use atomic `shared_`.
+// While not merged `shared_` holds `kBias` on behalf of the owner, so it can drop below its
+// initial value when foreign threads release references taken by the owner.
+// The owner merges `biased_` into `shared_` when it reaches zero.
+// An object released by a foreign thread is destroyed at the owner's next drain point.
+
+class BiasedCounter {
+    friend BiasedOwner;
+
+public:
+    // A drain point: counters handed back to this thread are merged first, so objects released
+    // by foreign threads may be destroyed inside the `MakeShared` that creates this counter.
+    // Their destructors must not need locks held around the creation.
+    BiasedCounter() : owner_(BiasedOwner::Current()) {
+        if (!owner_) {
+            // Created while the thread exits: a plain atomic counter from the start
+            merged_ = true;
+            biased_.store(0, std::memory_order_relaxed);
+            shared_.store(1, std::memory_order_relaxed);
+            return;
+        }
+        owner_->Ref();
+        owner_->Drain();
+    }
+
+    ~BiasedCounter() {
+        if (owner_) {
+            owner_->Unref();
+        }
+    }
+
+    BiasedCounter(const BiasedCounter&) = delete;
+    BiasedCounter& operator=(const BiasedCounter&) = delete;
+
+    // Called by the control block to run on the last strong reference
+    void Bind(void* block, void (*release)(void*)) {
+        block_ = block;
+        release_ = release;
+    }
+
+    void IncreaseStrong() {
+        if (IsBiased()) {
+            biased_.store(biased_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        } else {
+            shared_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Fails once the count is zero, including the window in which foreign releases have
+    // brought it to zero and the counter waits for the owner to drain it
+    bool TryIncreaseStrong() {
+        if (IsBiased()) {
+            if (GetStrong() == 0) {
+                return false;
+            }
+            IncreaseStrong();
+            return true;
+        }
+        int64_t value = shared_.load(std::memory_order_relaxed);
+        while (GetForeignStrong(value) > 0) {
+            if (shared_.compare_exchange_weak(value, value + 1, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns true when the last strong reference is gone
+    bool DecreaseStrong() {
+        if (IsBiased()) {
+            size_t biased = biased_.load(std::memory_order_relaxed) - 1;
+            biased_.store(biased, std::memory_order_relaxed);
+            return biased == 0 && Merge() == 0;
+        }
+        int64_t value = shared_.load(std::memory_order_relaxed);
+        int64_t next;
+        do {
+            next = value - 1;
+            if (IsUnmerged(value) && !(value & kQueued) && (next & ~kQueued) < kBias) {
+                next |= kQueued;
+            }
+        } while (!shared_.compare_exchange_weak(value, next, std::memory_order_acq_rel));
+        if ((next & kQueued) && !(value & kQueued) && !owner_->Push(this)) {
+            // The owner has exited, nobody else will merge this counter
+            Merge();
+            return Dequeue() == 0;
+        }
+        return next == 0;
+    }
+
+    size_t GetStrong() const {
+        int64_t value = shared_.load(std::memory_order_relaxed) & ~kQueued;
+        if (IsUnmerged(value)) {
+            value += static_cast<int64_t>(biased_.load(std::memory_order_relaxed)) - kBias;
+        }
+        return value;
+    }
+
+    void IncreaseWeak() {
+        MultiThreaded::Increment(weak_);
+    }
+
+    // Returns true when the block is not referenced anymore
+    bool DecreaseWeak() {
+        return MultiThreaded::Decrement(weak_) == 0;
+    }
+
+    // See `StrongWeakCounter::DecreaseWeakOnExpiry()`
+    bool DecreaseWeakOnExpiry() {
+        return MultiThreaded::LoadAcquire(weak_) == 1 || DecreaseWeak();
+    }
+
+    size_t GetWeak() const {
+        return MultiThreaded::Load(weak_) - (GetStrong() != 0);
+    }
+
+private:
+    static constexpr int64_t kBias = int64_t{1} << 40;
+    static constexpr int64_t kQueued = int64_t{1} << 61;
+
+    static bool IsUnmerged(int64_t value) {
+        return (value & ~kQueued) >= kBias / 2;
+    }
+
+    bool IsBiased() const {
+        return BiasedOwner::IsCurrent(owner_) && !merged_;
+    }
+
+    // Strong count as seen by a foreign thread, `value` is a load of `shared_` and is reloaded
+    // until `biased_` is read against a `shared_` that did not change meanwhile
+    int64_t GetForeignStrong(int64_t& value) const {
+        while (IsUnmerged(value)) {
+            // Pairs with the release in `Merge()`: a zeroed `biased_` comes with merged `shared_`
+            int64_t biased = biased_.load(std::memory_order_acquire);
+            int64_t current = shared_.load(std::memory_order_relaxed);
+            if (current == value) {
+                return biased + (value & ~kQueued) - kBias;
+            }
+            value = current;
+        }
+        return value & ~kQueued;
+    }
+
+    // Moves biased references to `shared_`, returns the new count ignoring `kQueued`.
+    // Zero with `kQueued` set is left for `Dequeue()` to report.
+    int64_t Merge() {
+        merged_ = true;
+        int64_t delta = static_cast<int64_t>(biased_.load(std::memory_order_relaxed)) - kBias;
+        int64_t value = shared_.fetch_add(delta, std::memory_order_acq_rel) + delta;
+        biased_.store(0, std::memory_order_release);
+        return (value & kQueued) ? -1 : value;
+    }
+
+    // Clears `kQueued`, returns the remaining count
+    int64_t Dequeue() {
+        return shared_.fetch_sub(kQueued, std::memory_order_acq_rel) - kQueued;
+    }
+
+    // Handed back to the owner thread
+    static void OnReturned(BiasedCounter* counter) {
+        if (!counter->merged_) {
+            counter->Merge();
+        }
+        if (counter->Dequeue() == 0) {
+            counter->release_(counter->block_);
+        }
+    }
+
+    BiasedOwner* owner_;
+    bool merged_ = false;
+    std::atomic<size_t> biased_ = 1;
+    std::atomic<int64_t> shared_ = kBias;
+    MultiThreaded::Count weak_{1};
+    BiasedCounter* next_ = nullptr;
+    void* block_ = nullptr;
+    void (*release_)(void*) = nullptr;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Policy for `SharedPtr<T, BiasedSharedPolicy>`.
+// Creating a block may run destructors of other objects of the thread, see `BiasedCounter()`.
+
+struct BiasedSharedPolicy {
+    using Counter = BiasedCounter;
+
+    static constexpr bool kWeak = true;
+};
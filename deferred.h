@@ -0,0 +1,158 @@
+#pragma once
+
+#include "slab.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Deferred destruction: objects whose last reference is gone are pushed to a lock-free queue
+// instead of being destroyed in place, so a destructor cascade does not run on the thread
+// that dropped the reference. The queue is emptied by a background thread (`Start()`)
+// or by `Drain()` at safe points of the application.
+
+class DeferredReclaimer {
+public:
+    // Intentionally leaked: statics and thread-locals of any translation unit may retire their
+    // objects while the process exits
+    static DeferredReclaimer& Global() {
+        static DeferredReclaimer* reclaimer = new DeferredReclaimer();
+        return *reclaimer;
+    }
+
+    // `destroy(object)` runs on the reclaiming thread
+    void Retire(void* object, void (*destroy)(void*)) {
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        Node* head = head_.load(std::memory_order_relaxed);
+        auto* node = new (NodePool::Allocate()) Node{object, destroy, head};
+        while (!head_.compare_exchange_weak(head, node, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+            node->next = head;
+        }
+        // `node` may already be drained, only the local copy of its link is safe to read
+        if (!head) {
+            // The queue was empty: wake up the background thread
+            signal_.fetch_add(1, std::memory_order_release);
+            signal_.notify_one();
+        }
+    }
+
+    template <class T>
+    void Retire(T* object) {
+        Retire(object, [](void* pointer) { delete static_cast<T*>(pointer); });
+    }
+
+    // Destroys everything retired so far, including objects retired by these destructors.
+    // Returns the number of destroyed objects.
+    size_t Drain() {
+        size_t count = 0;
+        while (Node* list = head_.exchange(nullptr, std::memory_order_acquire)) {
+            // Destroy in the order of retirement
+            Node* reversed = nullptr;
+            while (list) {
+                Node* next = list->next;
+                list->next = reversed;
+                reversed = list;
+                list = next;
+            }
+            while (reversed) {
+                Node* next = reversed->next;
+                reversed->destroy(reversed->object);
+                NodePool::Deallocate(reversed);
+                reversed = next;
+                ++count;
+            }
+        }
+        pending_.fetch_sub(count, std::memory_order_relaxed);
+        return count;
+    }
+
+    // Number of objects waiting for destruction
+    size_t Pending() const {
+        return pending_.load(std::memory_order_relaxed);
+    }
+
+    // Start a background thread draining the queue whenever it becomes non-empty
+    void Start() {
+        std::lock_guard lock(thread_mutex_);
+        if (thread_.joinable()) {
+            return;
+        }
+        stop_.store(false, std::memory_order_relaxed);
+        thread_ = std::thread([this] {
+            while (true) {
+                uint32_t seen = signal_.load(std::memory_order_acquire);
+                Drain();
+                if (stop_.load(std::memory_order_acquire)) {
+                    break;
+                }
+                signal_.wait(seen, std::memory_order_acquire);
+            }
+            NodePool::TrimCurrentThread();
+        });
+    }
+
+    // Stop the background thread after it drains the queue
+    void Stop() {
+        std::lock_guard lock(thread_mutex_);
+        if (!thread_.joinable()) {
+            return;
+        }
+        stop_.store(true, std::memory_order_release);
+        signal_.fetch_add(1, std::memory_order_release);
+        signal_.notify_one();
+        thread_.join();
+    }
+
+private:
+    struct Node {
+        void* object;
+        void (*destroy)(void*);
+        Node* next;
+    };
+
+    using NodePool = SlabPool<sizeof(Node), alignof(Node)>;
+
+    std::atomic<Node*> head_ = nullptr;
+    std::atomic<size_t> pending_ = 0;
+    // Bumped when the queue becomes non-empty and on `Stop()`
+    std::atomic<uint32_t> signal_ = 0;
+    std::atomic<bool> stop_ = false;
+    std::mutex thread_mutex_;
+    std::thread thread_;
+};
+
+// Destroys a single object (not an array) on the reclaimer instead of in place.
+// A deleter for `SharedPtr` and `UniquePtr`: `SharedPtr<T>(new T, DeferredDelete())`,
+// and a `Deleter` for `RefCounted`: `RefCounted<T, ThreadSafeCounter, DeferredDelete>`.
+struct DeferredDelete {
+    template <typename T>
+    void operator()(T* object) const {
+        Destroy(object);
+    }
+
+    template <typename T>
+    static void Destroy(T* object) {
+        if (object) {
+            DeferredReclaimer::Global().Retire(object);
+        }
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Policy wrapper: when the last `SharedPtr<T, DeferredDestruction<Policy>>` is gone, the block
+// is handed to the reclaimer, which destroys the object and releases the block. Covers objects
+// created by `MakeShared`, which `DeferredDelete` cannot reach. `WeakPtr`s expire immediately.
+
+template <class Policy>
+struct DeferredDestruction : Policy {
+    static constexpr bool kDeferredDestruction = true;
+};
+
+template <class Policy>
+inline constexpr bool kDefersDestruction = requires { requires Policy::kDeferredDestruction; };
@@ -0,0 +1,273 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Hazard pointers: a reader publishes the address it is about to dereference,
+// reclamation of retired objects waits until no published address covers them.
+
+struct HazardRecord {
+    std::atomic<const void*> pointer = nullptr;
+    std::atomic<bool> active = false;
+    HazardRecord* next = nullptr;
+};
+
+class HazardDomain {
+public:
+    // Outlives static destruction: every exiting thread hands its retired objects and its
+    // records back here, and detached threads may exit after `main`
+    static HazardDomain& Global() {
+        static HazardDomain* domain = new HazardDomain();
+        return *domain;
+    }
+
+    HazardRecord* AcquireRecord() {
+        for (HazardRecord* record = records_.load(std::memory_order_acquire); record;
+             record = record->next) {
+            bool active = false;
+            if (!record->active.load(std::memory_order_relaxed) &&
+                record->active.compare_exchange_strong(active, true, std::memory_order_acquire)) {
+                return record;
+            }
+        }
+        auto* record = new HazardRecord();
+        record->active.store(true, std::memory_order_relaxed);
+        record->next = records_.load(std::memory_order_relaxed);
+        while (!records_.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        }
+        record_count_.fetch_add(1, std::memory_order_relaxed);
+        return record;
+    }
+
+    void ReleaseRecord(HazardRecord* record) {
+        record->pointer.store(nullptr, std::memory_order_release);
+        record->active.store(false, std::memory_order_release);
+    }
+
+    // `reclaim(object)` runs once no hazard pointer covers `object`
+    void Retire(void* object, void (*reclaim)(void*)) {
+        std::vector<Retired>& retired = LocalRetired().items;
+        retired.push_back({object, reclaim});
+        if (retired.size() >= 2 * record_count_.load(std::memory_order_relaxed) + kScanThreshold) {
+            Scan(retired);
+        }
+    }
+
+    // Reclaim everything retired by this thread that is not protected right now
+    void Flush() {
+        Scan(LocalRetired().items);
+    }
+
+    template <typename T>
+    friend class HazardGuard;
+
+private:
+    struct Retired {
+        void* object;
+        void (*reclaim)(void*);
+    };
+
+    // Objects retired by the current thread. Those of an exiting thread are adopted
+    // by the next scan in any thread.
+    struct RetiredList {
+        ~RetiredList() {
+            HazardDomain& domain = Global();
+            std::lock_guard guard(domain.orphans_mutex_);
+            domain.orphans_.insert(domain.orphans_.end(), items.begin(), items.end());
+        }
+
+        std::vector<Retired> items;
+    };
+
+    // Records cached by the current thread, so guards do not walk the global list
+    struct RecordCache {
+        ~RecordCache() {
+            for (HazardRecord* record : free) {
+                Global().ReleaseRecord(record);
+            }
+        }
+
+        std::vector<HazardRecord*> free;
+    };
+
+    static constexpr size_t kScanThreshold = 64;
+
+    static RetiredList& LocalRetired() {
+        static thread_local RetiredList retired;
+        return retired;
+    }
+
+    static RecordCache& LocalRecords() {
+        static thread_local RecordCache cache;
+        return cache;
+    }
+
+    void Scan(std::vector<Retired>& retired) {
+        {
+            std::lock_guard guard(orphans_mutex_);
+            retired.insert(retired.end(), orphans_.begin(), orphans_.end());
+            orphans_.clear();
+        }
+        std::vector<const void*> hazards;
+        for (HazardRecord* record = records_.load(std::memory_order_acquire); record;
+             record = record->next) {
+            if (const void* pointer = record->pointer.load(std::memory_order_seq_cst)) {
+                hazards.push_back(pointer);
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+        std::vector<Retired> reclaim;
+        auto protected_end = std::partition(retired.begin(), retired.end(), [&](const Retired& item) {
+            return std::binary_search(hazards.begin(), hazards.end(), item.object);
+        });
+        reclaim.assign(protected_end, retired.end());
+        retired.erase(protected_end, retired.end());
+        // Reclaiming may retire more objects into `retired`
+        for (const Retired& item : reclaim) {
+            item.reclaim(item.object);
+        }
+    }
+
+    std::atomic<HazardRecord*> records_ = nullptr;
+    std::atomic<size_t> record_count_ = 0;
+    std::mutex orphans_mutex_;
+    std::vector<Retired> orphans_;
+};
+
+// Protects a single pointer loaded from an atomic source
+template <typename T>
+class HazardGuard {
+public:
+    HazardGuard() {
+        std::vector<HazardRecord*>& cache = HazardDomain::LocalRecords().free;
+        if (cache.empty()) {
+            record_ = HazardDomain::Global().AcquireRecord();
+        } else {
+            record_ = cache.back();
+            cache.pop_back();
+        }
+    }
+
+    HazardGuard(const HazardGuard&) = delete;
+    HazardGuard& operator=(const HazardGuard&) = delete;
+
+    ~HazardGuard() {
+        Reset();
+        HazardDomain::LocalRecords().free.push_back(record_);
+    }
+
+    // Load `source` and keep the result from being reclaimed while the guard holds it
+    T* Protect(const std::atomic<T*>& source) {
+        T* pointer = source.load(std::memory_order_relaxed);
+        while (true) {
+            record_->pointer.store(pointer, std::memory_order_seq_cst);
+            T* current = source.load(std::memory_order_seq_cst);
+            if (current == pointer) {
+                break;
+            }
+            pointer = current;
+        }
+        pointer_ = pointer;
+        return pointer;
+    }
+
+    void Reset() {
+        record_->pointer.store(nullptr, std::memory_order_release);
+        pointer_ = nullptr;
+    }
+
+    T* Get() const {
+        return pointer_;
+    }
+
+    T& operator*() const {
+        return *pointer_;
+    }
+
+    T* operator->() const {
+        return pointer_;
+    }
+
+    explicit operator bool() const {
+        return pointer_;
+    }
+
+private:
+    HazardRecord* record_;
+    T* pointer_ = nullptr;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Integration with `RefCounted`
+
+// Deleter for `RefCounted` objects read through raw pointers under `HazardGuard`:
+// the object is destroyed only once no hazard pointer covers it
+struct HazardDelete {
+    template <typename T>
+    static void Destroy(T* object) {
+        HazardDomain::Global().Retire(object, [](void* pointer) {
+            delete static_cast<T*>(pointer);
+        });
+    }
+};
+
+// Shared `IntrusivePtr` field readable from many threads.
+// The reference held by the field is dropped only when no hazard pointer covers the object,
+// so a protected object always has a non-zero counter. `Protect` does not touch the counter,
+// `Load` takes a reference and needs a thread-safe counter in `T` (`ThreadSafeRefCounted`).
+template <typename T>
+class AtomicIntrusivePtr {
+public:
+    AtomicIntrusivePtr() {
+    }
+
+    AtomicIntrusivePtr(IntrusivePtr<T> value) : ptr_(std::exchange(value.ptr_, nullptr)) {
+    }
+
+    AtomicIntrusivePtr(const AtomicIntrusivePtr&) = delete;
+    AtomicIntrusivePtr& operator=(const AtomicIntrusivePtr&) = delete;
+
+    ~AtomicIntrusivePtr() {
+        Retire(ptr_.load(std::memory_order_relaxed));
+    }
+
+    // Read without touching the reference counter
+    T* Protect(HazardGuard<T>& guard) const {
+        return guard.Protect(ptr_);
+    }
+
+    IntrusivePtr<T> Load() const {
+        HazardGuard<T> guard;
+        return IntrusivePtr<T>(guard.Protect(ptr_));
+    }
+
+    void Store(IntrusivePtr<T> desired) {
+        Retire(ptr_.exchange(std::exchange(desired.ptr_, nullptr), std::memory_order_seq_cst));
+    }
+
+    IntrusivePtr<T> Exchange(IntrusivePtr<T> desired) {
+        T* previous = ptr_.exchange(std::exchange(desired.ptr_, nullptr), std::memory_order_seq_cst);
+        IntrusivePtr<T> result(previous);
+        Retire(previous);
+        return result;
+    }
+
+private:
+    static void Retire(T* object) {
+        if (object) {
+            HazardDomain::Global().Retire(object, [](void* pointer) {
+                static_cast<T*>(pointer)->DecRef();
+            });
+        }
+    }
+
+    std::atomic<T*> ptr_ = nullptr;
+};
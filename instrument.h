@@ -0,0 +1,302 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Opt-in counters of allocations and reference count operations, aggregated per payload type.
+// Compiled in only with `SMART_PTR_INSTRUMENT` defined (CMake option of the same name);
+// otherwise the hooks expand to nothing and no pointer or block carries extra state.
+//
+// Every thread increments its own counters with plain relaxed stores, `Snapshot()` sums the
+// counters of running threads with those left by threads that have exited.
+
+enum class InstrumentEvent : size_t {
+    kAllocation,
+    kFree,
+    kAllocatedBytes,
+    kFreedBytes,
+    kIncreaseStrong,
+    kDecreaseStrong,
+    kWeakPromotion,
+    kFailedWeakPromotion,
+};
+
+inline constexpr size_t kInstrumentEvents = 8;
+
+inline constexpr std::array<const char*, kInstrumentEvents> kInstrumentEventNames = {
+    "allocations",
+    "frees",
+    "allocated_bytes",
+    "freed_bytes",
+    "strong_increments",
+    "strong_decrements",
+    "weak_promotions",
+    "failed_weak_promotions",
+};
+
+// Totals for one payload type
+struct InstrumentStats {
+    uint64_t Get(InstrumentEvent event) const {
+        return values[static_cast<size_t>(event)];
+    }
+
+    uint64_t LiveBytes() const {
+        return Get(InstrumentEvent::kAllocatedBytes) - Get(InstrumentEvent::kFreedBytes);
+    }
+
+    uint64_t LiveObjects() const {
+        return Get(InstrumentEvent::kAllocation) - Get(InstrumentEvent::kFree);
+    }
+
+    std::string type;
+    std::array<uint64_t, kInstrumentEvents> values = {};
+};
+
+// `T` as spelled in the source, without RTTI
+template <class T>
+constexpr std::string_view TypeName() {
+    std::string_view name = __PRETTY_FUNCTION__;
+    size_t begin = name.find("T = ") + 4;
+    // GCC lists other aliases after `;`, otherwise the name runs up to the closing `]`
+    size_t end = name.find(';', begin);
+    if (end == std::string_view::npos) {
+        end = name.size() - 1;
+    }
+    return name.substr(begin, end - begin);
+}
+
+// Pointer families count under ids of their own, so the objects of `UniquePtr<Node>` and
+// `IntrusivePtr<Node>` do not mix with the blocks of `SharedPtr<Node>`. Types of the other
+// families are reported as `UniquePtr<Node>` and `IntrusivePtr<Node>`.
+struct SharedFamily {
+    static constexpr std::string_view kName = "";
+};
+
+struct UniqueFamily {
+    static constexpr std::string_view kName = "UniquePtr";
+};
+
+struct IntrusiveFamily {
+    static constexpr std::string_view kName = "IntrusivePtr";
+};
+
+class Instrumentation {
+public:
+    // Dense id of `T` in `Family`, assigned on first use
+    template <class T, class Family = SharedFamily>
+    static uint32_t TypeId() {
+        static const uint32_t id = Global().Register(Family::kName, TypeName<T>());
+        return id;
+    }
+
+    static void Add(uint32_t type, InstrumentEvent event, uint64_t value = 1) {
+        ThreadCounters* counters = LocalCounters();
+        if (!counters) {
+            Global().AddRetired(type, event, value);
+            return;
+        }
+        std::atomic<uint64_t>& counter = counters->Get(type)[static_cast<size_t>(event)];
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    // Types with any recorded event, the largest live footprint first
+    static std::vector<InstrumentStats> Snapshot() {
+        return Global().Collect();
+    }
+
+    static std::string ToText(const std::vector<InstrumentStats>& snapshot) {
+        std::string text;
+        char line[64];
+        for (const auto& stats : snapshot) {
+            text += stats.type;
+            text += '\n';
+            for (size_t event = 0; event < kInstrumentEvents; ++event) {
+                std::snprintf(line, sizeof(line), "  %-24s %llu\n", kInstrumentEventNames[event],
+                              static_cast<unsigned long long>(stats.values[event]));
+                text += line;
+            }
+        }
+        return text;
+    }
+
+    static std::string ToJson(const std::vector<InstrumentStats>& snapshot) {
+        std::string json = "[";
+        for (const auto& stats : snapshot) {
+            if (json.size() > 1) {
+                json += ',';
+            }
+            json += "{\"type\":\"";
+            for (char c : stats.type) {
+                if (c == '"' || c == '\\') {
+                    json += '\\';
+                }
+                json += c;
+            }
+            json += '"';
+            for (size_t event = 0; event < kInstrumentEvents; ++event) {
+                json += ",\"";
+                json += kInstrumentEventNames[event];
+                json += "\":";
+                json += std::to_string(stats.values[event]);
+            }
+            json += '}';
+        }
+        json += ']';
+        return json;
+    }
+
+private:
+    using Counters = std::array<std::atomic<uint64_t>, kInstrumentEvents>;
+
+    static constexpr size_t kMaxTypes = 1 << 14;
+
+    // Counters of one thread, allocated in chunks of types as they show up.
+    // Only the owner writes them, so reading a chunk needs no lock.
+    class ThreadCounters {
+    public:
+        ~ThreadCounters() {
+            for (auto& chunk : chunks_) {
+                delete[] chunk.load(std::memory_order_relaxed);
+            }
+        }
+
+        Counters& Get(uint32_t type) {
+            auto& slot = chunks_[type / kChunk];
+            Counters* chunk = slot.load(std::memory_order_acquire);
+            if (!chunk) {
+                chunk = new Counters[kChunk]();
+                slot.store(chunk, std::memory_order_release);
+            }
+            return chunk[type % kChunk];
+        }
+
+        void AddTo(std::vector<InstrumentStats>* totals) const {
+            for (size_t type = 0; type < totals->size(); ++type) {
+                const Counters* chunk = chunks_[type / kChunk].load(std::memory_order_acquire);
+                if (!chunk) {
+                    continue;
+                }
+                for (size_t event = 0; event < kInstrumentEvents; ++event) {
+                    (*totals)[type].values[event] +=
+                        chunk[type % kChunk][event].load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+    private:
+        static constexpr size_t kChunk = 64;
+
+        std::array<std::atomic<Counters*>, kMaxTypes / kChunk> chunks_ = {};
+    };
+
+    // Leaked on purpose: `Owner` of each thread folds its counters in here at thread exit,
+    // which for detached threads may come after `main` has returned
+    static Instrumentation& Global() {
+        static Instrumentation* global = new Instrumentation();
+        return *global;
+    }
+
+    // Null once the thread has folded its counters: thread-local destructors that run later
+    // may still release pointers
+    static ThreadCounters* LocalCounters() {
+        if (!local_counters && !exited) {
+            static thread_local Owner owner;
+        }
+        return local_counters;
+    }
+
+    // Registers the counters of a thread, folds them into `retired_` when it exits
+    struct Owner {
+        Owner() : counters(new ThreadCounters()) {
+            Instrumentation& global = Global();
+            std::lock_guard lock(global.mutex_);
+            global.threads_.push_back(counters);
+            local_counters = counters;
+        }
+
+        ~Owner() {
+            local_counters = nullptr;
+            exited = true;
+            Instrumentation& global = Global();
+            std::lock_guard lock(global.mutex_);
+            global.retired_.resize(global.names_.size());
+            counters->AddTo(&global.retired_);
+            std::erase(global.threads_, counters);
+            delete counters;
+        }
+
+        ThreadCounters* counters;
+    };
+
+    // Events of exiting threads after their counters are folded
+    void AddRetired(uint32_t type, InstrumentEvent event, uint64_t value) {
+        std::lock_guard lock(mutex_);
+        retired_.resize(std::max<size_t>(retired_.size(), type + 1));
+        retired_[type].values[static_cast<size_t>(event)] += value;
+    }
+
+    uint32_t Register(std::string_view family, std::string_view name) {
+        std::lock_guard lock(mutex_);
+        if (names_.size() == kMaxTypes) {
+            // Everything else is accounted to the last type
+            return kMaxTypes - 1;
+        }
+        if (family.empty()) {
+            names_.emplace_back(name);
+        } else {
+            names_.push_back(std::string(family) + '<' + std::string(name) + '>');
+        }
+        return names_.size() - 1;
+    }
+
+    std::vector<InstrumentStats> Collect() {
+        std::vector<InstrumentStats> totals;
+        {
+            std::lock_guard lock(mutex_);
+            totals = retired_;
+            totals.resize(names_.size());
+            for (size_t type = 0; type < names_.size(); ++type) {
+                totals[type].type = names_[type];
+            }
+            for (const ThreadCounters* counters : threads_) {
+                counters->AddTo(&totals);
+            }
+        }
+        std::erase_if(totals, [](const InstrumentStats& stats) {
+            return std::all_of(stats.values.begin(), stats.values.end(),
+                               [](uint64_t value) { return value == 0; });
+        });
+        std::stable_sort(totals.begin(), totals.end(),
+                         [](const InstrumentStats& left, const InstrumentStats& right) {
+                             return left.LiveBytes() > right.LiveBytes();
+                         });
+        return totals;
+    }
+
+    std::mutex mutex_;
+    std::vector<std::string> names_;
+    std::vector<ThreadCounters*> threads_;
+    std::vector<InstrumentStats> retired_;
+
+    static inline thread_local ThreadCounters* local_counters = nullptr;
+    static inline thread_local bool exited = false;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Hooks used by the pointers
+
+#ifdef SMART_PTR_INSTRUMENT
+#define SMART_PTR_COUNT(type_id, event, value) \
+    Instrumentation::Add(type_id, InstrumentEvent::event, value)
+#else
+#define SMART_PTR_COUNT(type_id, event, value) ((void)0)
+#endif
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "instrument.h"
+#include "relocate.h"
+
+#include <atomic>
 #include <cstddef>  // for std::nullptr_t
 #include <utility>  // for std::exchange / std::swap
 
@@ -10,6 +14,15 @@ public:
         return count_;
     }
 
+    // Fails once the count has dropped to zero
+    bool TryIncRef() {
+        if (count_ == 0) {
+            return false;
+        }
+        ++count_;
+        return true;
+    }
+
     size_t DecRef() {
         if (count_ > 0) {
             --count_;
@@ -25,6 +38,52 @@ private:
     size_t count_ = 0;
 };
 
+// Counter for objects shared between threads
+class ThreadSafeCounter {
+public:
+    size_t IncRef() {
+        return count_.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    // Fails once the count has dropped to zero
+    bool TryIncRef() {
+        size_t count = count_.load(std::memory_order_relaxed);
+        while (count != 0) {
+            if (count_.compare_exchange_weak(count, count + 1, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t DecRef() {
+#if defined(__SANITIZE_THREAD__)
+        // TSan does not model standalone fences
+        return count_.fetch_sub(1, std::memory_order_acq_rel) - 1;
+#else
+        size_t count = count_.fetch_sub(1, std::memory_order_release) - 1;
+        if (count == 0) {
+            // Make all writes of other owners visible to the destructor
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return count;
+#endif
+    }
+
+    size_t RefCount() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<size_t> count_ = 0;
+};
+
+inline constexpr size_t kCacheLineSize = 64;
+
+// Keeps the counter on its own cache line, so contended reference counting
+// does not slow down readers of the payload fields that follow it
+class alignas(kCacheLineSize) PaddedThreadSafeCounter : public ThreadSafeCounter {};
+
 struct DefaultDelete {
     template <typename T>
     static void Destroy(T* object) {
@@ -35,31 +94,63 @@ struct DefaultDelete {
 template <typename Derived, typename Counter, typename Deleter>
 class RefCounted {
 public:
+    // Instrumentation counts an object once it is first referenced and frees it with the last
+    // reference, objects on the stack or inside others are not counted.
+
     // Increase reference counter.
     void IncRef() {
-        counter_.IncRef();
+        SMART_PTR_COUNT(TypeId(), kIncreaseStrong, 1);
+        [[maybe_unused]] size_t count = counter_.IncRef();
+        SMART_PTR_COUNT(TypeId(), kAllocation, count == 1);
+        SMART_PTR_COUNT(TypeId(), kAllocatedBytes, count == 1 ? sizeof(Derived) : 0);
     }
 
     // Decrease reference counter.
     // Destroy object using Deleter when the last instance dies.
     void DecRef() {
+        SMART_PTR_COUNT(TypeId(), kDecreaseStrong, 1);
         if (counter_.DecRef() == 0) {
+            SMART_PTR_COUNT(TypeId(), kFree, 1);
+            SMART_PTR_COUNT(TypeId(), kFreedBytes, sizeof(Derived));
             Deleter::Destroy(static_cast<Derived*>(this));  // !!!
         }
     }
 
+    // Increase reference counter unless the object is already being destroyed.
+    bool TryIncRef() {
+        bool promoted = counter_.TryIncRef();
+        SMART_PTR_COUNT(TypeId(), kWeakPromotion, promoted);
+        SMART_PTR_COUNT(TypeId(), kFailedWeakPromotion, !promoted);
+        return promoted;
+    }
+
     // Get current counter value (the number of strong references).
     size_t RefCount() const {
         return counter_.RefCount();
     }
 
+    // Side table of weak references, only for counters that support them (`WeakCounter`).
+    auto* GetWeakTable() {
+        return counter_.GetWeakTable();
+    }
+
 private:
+    static uint32_t TypeId() {
+        return Instrumentation::TypeId<Derived, IntrusiveFamily>();
+    }
+
     Counter counter_;
 };
 
 template <typename Derived, typename D = DefaultDelete>
 using SimpleRefCounted = RefCounted<Derived, SimpleCounter, D>;
 
+template <typename Derived, typename D = DefaultDelete>
+using ThreadSafeRefCounted = RefCounted<Derived, ThreadSafeCounter, D>;
+
+template <typename Derived, typename D = DefaultDelete>
+using PaddedThreadSafeRefCounted = RefCounted<Derived, PaddedThreadSafeCounter, D>;
+
 template <typename T>
 class IntrusivePtr {
     template <typename Y>
@@ -87,7 +178,7 @@ public:
     }
 
     template <typename Y>
-    IntrusivePtr(IntrusivePtr<Y>&& other) : ptr_(other.ptr_) {
+    IntrusivePtr(IntrusivePtr<Y>&& other) noexcept : ptr_(other.ptr_) {
         other.ptr_ = nullptr;
     }
 
@@ -97,7 +188,7 @@ public:
         }
     }
 
-    IntrusivePtr(IntrusivePtr&& other) : ptr_(other.ptr_) {
+    IntrusivePtr(IntrusivePtr&& other) noexcept : ptr_(other.ptr_) {
         other.ptr_ = nullptr;
     }
 
@@ -116,7 +207,7 @@ public:
         return *this;
     }
 
-    IntrusivePtr& operator=(IntrusivePtr&& other) {
+    IntrusivePtr& operator=(IntrusivePtr&& other) noexcept {
         if (this == &other) {
             return *this;
         }
@@ -141,7 +232,7 @@ public:
     }
 
     template <class X>
-    IntrusivePtr& operator=(IntrusivePtr<X>&& other) {
+    IntrusivePtr& operator=(IntrusivePtr<X>&& other) noexcept {
         if (ptr_) {
             ptr_->DecRef();
         }
@@ -175,7 +266,7 @@ public:
         }
     }
 
-    void Swap(IntrusivePtr& other) {
+    void Swap(IntrusivePtr& other) noexcept {
         std::swap(ptr_, other.ptr_);
     }
 
@@ -206,6 +297,9 @@ public:
     T* ptr_ = nullptr;
 };
 
+template <typename T>
+struct IsTriviallyRelocatable<IntrusivePtr<T>> : std::true_type {};
+
 template <typename T, typename... Args>
 IntrusivePtr<T> MakeIntrusive(Args&&... args) {
     T* ptr = new T(std::forward<Args>(args)...);
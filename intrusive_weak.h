@@ -0,0 +1,227 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <atomic>
+#include <cstddef>  // for std::nullptr_t
+#include <thread>
+#include <utility>  // for std::swap
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Weak references to `RefCounted` objects. The object keeps a single pointer to a side table,
+// which is allocated when the first weak reference is taken, so objects that are never
+// weakly referenced pay one null pointer. The table outlives the object while weak
+// references remain and tells them whether the object is still there.
+
+class IntrusiveWeakTable {
+public:
+    void Ref() {
+        refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Unref() {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    // Runs `function()` unless the object is gone; the object is not freed meanwhile.
+    // Returns false for a gone object, otherwise the result of `function()`.
+    template <class Function>
+    bool Visit(Function function) {
+        Guard guard(this);
+        return alive_ && function();
+    }
+
+    // Called by the object as it is destroyed
+    void Expire() {
+        {
+            Guard guard(this);
+            alive_ = false;
+        }
+        Unref();
+    }
+
+private:
+    // Held for a few instructions only, a spinning lock costs less than a mutex
+    class Guard {
+    public:
+        explicit Guard(IntrusiveWeakTable* table) : table_(table) {
+            while (table_->locked_.exchange(true, std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+        }
+
+        ~Guard() {
+            table_->locked_.store(false, std::memory_order_release);
+        }
+
+    private:
+        IntrusiveWeakTable* table_;
+    };
+
+    // One reference belongs to the object until it expires
+    std::atomic<size_t> refs_ = 1;
+    std::atomic<bool> locked_ = false;
+    bool alive_ = true;
+};
+
+// Adds the side table pointer to a counter of `RefCounted`
+template <class Counter>
+class WeakCounter : public Counter {
+public:
+    WeakCounter() = default;
+
+    ~WeakCounter() {
+        // The strong count is zero for good, weak references can no longer promote
+        if (IntrusiveWeakTable* table = table_.load(std::memory_order_acquire)) {
+            table->Expire();
+        }
+    }
+
+    // Only called by holders of a strong reference, so never concurrently with the destructor
+    IntrusiveWeakTable* GetWeakTable() {
+        IntrusiveWeakTable* table = table_.load(std::memory_order_acquire);
+        if (table) {
+            return table;
+        }
+        auto* fresh = new IntrusiveWeakTable();
+        if (table_.compare_exchange_strong(table, fresh, std::memory_order_acq_rel)) {
+            return fresh;
+        }
+        // Another thread installed its table first
+        delete fresh;
+        return table;
+    }
+
+private:
+    std::atomic<IntrusiveWeakTable*> table_ = nullptr;
+};
+
+template <typename Derived, typename D = DefaultDelete>
+using SimpleWeakRefCounted = RefCounted<Derived, WeakCounter<SimpleCounter>, D>;
+
+template <typename Derived, typename D = DefaultDelete>
+using ThreadSafeWeakRefCounted = RefCounted<Derived, WeakCounter<ThreadSafeCounter>, D>;
+
+template <typename T>
+class WeakIntrusivePtr {
+    template <typename Y>
+    friend class WeakIntrusivePtr;
+
+public:
+    // Constructors
+    WeakIntrusivePtr() {
+    }
+
+    WeakIntrusivePtr(std::nullptr_t) {
+    }
+
+    template <typename Y>
+    WeakIntrusivePtr(const IntrusivePtr<Y>& other) : ptr_(other.ptr_) {
+        if (ptr_) {
+            table_ = ptr_->GetWeakTable();
+            table_->Ref();
+        }
+    }
+
+    template <typename Y>
+    WeakIntrusivePtr(const WeakIntrusivePtr<Y>& other) : ptr_(other.ptr_), table_(other.table_) {
+        if (table_) {
+            table_->Ref();
+        }
+    }
+
+    WeakIntrusivePtr(const WeakIntrusivePtr& other) : ptr_(other.ptr_), table_(other.table_) {
+        if (table_) {
+            table_->Ref();
+        }
+    }
+
+    WeakIntrusivePtr(WeakIntrusivePtr&& other) noexcept : ptr_(other.ptr_), table_(other.table_) {
+        other.ptr_ = nullptr;
+        other.table_ = nullptr;
+    }
+
+    // `operator=`-s
+    WeakIntrusivePtr& operator=(const WeakIntrusivePtr& other) {
+        if (this == &other) {
+            return *this;
+        }
+        if (other.table_) {
+            other.table_->Ref();
+        }
+        if (table_) {
+            table_->Unref();
+        }
+        ptr_ = other.ptr_;
+        table_ = other.table_;
+        return *this;
+    }
+
+    WeakIntrusivePtr& operator=(WeakIntrusivePtr&& other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+        if (table_) {
+            table_->Unref();
+        }
+        ptr_ = other.ptr_;
+        table_ = other.table_;
+        other.ptr_ = nullptr;
+        other.table_ = nullptr;
+        return *this;
+    }
+
+    // Destructor
+    ~WeakIntrusivePtr() {
+        if (table_) {
+            table_->Unref();
+        }
+    }
+
+    // Modifiers
+    void Reset() {
+        if (table_) {
+            table_->Unref();
+        }
+        ptr_ = nullptr;
+        table_ = nullptr;
+    }
+
+    void Swap(WeakIntrusivePtr& other) noexcept {
+        std::swap(ptr_, other.ptr_);
+        std::swap(table_, other.table_);
+    }
+
+    // Observers
+    size_t UseCount() const {
+        size_t count = 0;
+        if (table_) {
+            table_->Visit([&] {
+                count = ptr_->RefCount();
+                return true;
+            });
+        }
+        return count;
+    }
+
+    bool Expired() const {
+        return UseCount() == 0;
+    }
+
+    IntrusivePtr<T> Lock() const {
+        IntrusivePtr<T> result;
+        if (table_ && table_->Visit([&] { return ptr_->TryIncRef(); })) {
+            // Adopt the reference taken by `TryIncRef`
+            result.ptr_ = ptr_;
+        }
+        return result;
+    }
+
+    T* ptr_ = nullptr;
+    IntrusiveWeakTable* table_ = nullptr;
+};
+
+template <typename T>
+struct IsTriviallyRelocatable<WeakIntrusivePtr<T>> : std::true_type {};
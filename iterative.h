@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Iterative teardown: an object released while another destruction runs on the same thread
+// is queued instead of being destroyed in place, and the outermost destruction destroys
+// the queue in a loop. Dropping a long chain of owners then takes constant stack depth.
+
+class IterativeTeardown {
+public:
+    static void Destroy(void* object, void (*destroy)(void*)) {
+        Pending& pending = LocalPending();
+        if (pending.active) {
+            pending.items.push_back({object, destroy});
+            return;
+        }
+        pending.active = true;
+        destroy(object);
+        // Most recently released first: usually the members of the object destroyed last
+        while (!pending.items.empty()) {
+            Item item = pending.items.back();
+            pending.items.pop_back();
+            item.destroy(item.object);
+        }
+        pending.active = false;
+    }
+
+    template <class T>
+    static void Destroy(T* object) {
+        Destroy(object, [](void* pointer) { delete static_cast<T*>(pointer); });
+    }
+
+private:
+    struct Item {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    struct Pending {
+        bool active = false;
+        std::vector<Item> items;
+    };
+
+    static Pending& LocalPending() {
+        static thread_local Pending pending;
+        return pending;
+    }
+};
+
+// Deletes a single object (not an array) through `IterativeTeardown`.
+// A deleter for `SharedPtr` and `UniquePtr`: `UniquePtr<Node, IterativeDelete>`,
+// and a `Deleter` for `RefCounted`: `RefCounted<Node, SimpleCounter, IterativeDelete>`.
+struct IterativeDelete {
+    template <typename T>
+    void operator()(T* object) const {
+        Destroy(object);
+    }
+
+    template <typename T>
+    static void Destroy(T* object) {
+        if (object) {
+            IterativeTeardown::Destroy(object);
+        }
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Policy wrapper: blocks of `SharedPtr<T, IterativeDestruction<Policy>>` that reach zero
+// during another teardown are queued, including the ones created by `MakeShared`
+
+template <class Policy>
+struct IterativeDestruction : Policy {
+    static constexpr bool kIterativeDestruction = true;
+};
+
+template <class Policy>
+inline constexpr bool kDestroysIteratively = requires { requires Policy::kIterativeDestruction; };
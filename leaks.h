@@ -0,0 +1,209 @@
+#pragma once
+
+#include "instrument.h"  // TypeName
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define SMART_PTR_HAS_BACKTRACE 1
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Registry of live control blocks for finding what pins memory: cycles of `SharedPtr`,
+// forgotten owners, `WeakPtr`s keeping blocks of dead objects. Compiled in only with
+// `SMART_PTR_TRACK_LEAKS` defined (CMake option of the same name).
+//
+// One block in `SampleRate()` is registered along with the backtrace of its creation.
+// The registry is split into shards by block address, so threads creating and freeing
+// blocks rarely meet on a lock. Symbol names in reports need `-rdynamic`.
+
+struct LeakCounts {
+    size_t strong;
+    size_t weak;
+};
+
+// Live sampled blocks created at one place
+struct LeakSite {
+    std::string type;
+    std::vector<std::string> frames;
+    size_t blocks = 0;
+    size_t bytes = 0;
+    // Blocks whose object is already destroyed, kept by weak references only
+    size_t expired = 0;
+    size_t strong = 0;
+    size_t weak = 0;
+    std::chrono::steady_clock::duration oldest{};
+};
+
+class LeakTracker {
+public:
+    using CountsFunction = LeakCounts (*)(const void* block);
+
+    // Register one block in `rate`; 1 registers every block
+    static void SetSampleRate(size_t rate) {
+        sample_rate.store(std::max<size_t>(rate, 1), std::memory_order_relaxed);
+    }
+
+    static size_t SampleRate() {
+        return sample_rate.load(std::memory_order_relaxed);
+    }
+
+    static bool ShouldSample() {
+        static thread_local size_t countdown = 1;
+        if (--countdown != 0) {
+            return false;
+        }
+        countdown = SampleRate();
+        return true;
+    }
+
+    static void Register(const void* block, std::string_view type, size_t bytes,
+                         CountsFunction counts) {
+        Entry entry{type, bytes, counts, std::chrono::steady_clock::now()};
+#ifdef SMART_PTR_HAS_BACKTRACE
+        void* frames[kMaxFrames + kSkippedFrames];
+        int depth = backtrace(frames, kMaxFrames + kSkippedFrames);
+        for (int i = kSkippedFrames; i < depth; ++i) {
+            entry.frames[entry.depth++] = frames[i];
+        }
+#endif
+        Shard& shard = GetShard(block);
+        std::lock_guard lock(shard.mutex);
+        shard.entries.emplace(block, entry);
+    }
+
+    static void Unregister(const void* block) {
+        Shard& shard = GetShard(block);
+        std::lock_guard lock(shard.mutex);
+        shard.entries.erase(block);
+    }
+
+    // Sites with the most live bytes among blocks older than `min_age`
+    static std::vector<LeakSite> TopSites(size_t limit,
+                                          std::chrono::steady_clock::duration min_age = {}) {
+        using Key = std::pair<std::string_view, std::vector<void*>>;
+        std::map<Key, LeakSite> sites;
+        auto now = std::chrono::steady_clock::now();
+        for (Shard& shard : Shards()) {
+            std::lock_guard lock(shard.mutex);
+            for (const auto& [block, entry] : shard.entries) {
+                auto age = now - entry.created;
+                if (age < min_age) {
+                    continue;
+                }
+                // The block cannot be freed while its shard is locked
+                LeakCounts counts = entry.counts(block);
+                std::vector<void*> frames(entry.frames.begin(), entry.frames.begin() + entry.depth);
+                LeakSite& site = sites[{entry.type, std::move(frames)}];
+                site.blocks += 1;
+                site.bytes += entry.bytes;
+                site.expired += counts.strong == 0;
+                site.strong += counts.strong;
+                site.weak += counts.weak;
+                site.oldest = std::max(site.oldest, age);
+            }
+        }
+
+        std::vector<LeakSite> result;
+        for (auto& [key, site] : sites) {
+            site.type = key.first;
+            site.frames = Symbolize(key.second);
+            result.push_back(std::move(site));
+        }
+        std::sort(result.begin(), result.end(), [](const LeakSite& left, const LeakSite& right) {
+            return left.bytes > right.bytes;
+        });
+        if (result.size() > limit) {
+            result.resize(limit);
+        }
+        return result;
+    }
+
+    static std::string ToText(const std::vector<LeakSite>& sites) {
+        std::string text;
+        char line[160];
+        for (const auto& site : sites) {
+            auto age = std::chrono::duration_cast<std::chrono::milliseconds>(site.oldest);
+            std::snprintf(line, sizeof(line),
+                          "%zu blocks, %zu bytes, %zu expired, strong %zu, weak %zu, "
+                          "oldest %lld ms: ",
+                          site.blocks, site.bytes, site.expired, site.strong, site.weak,
+                          static_cast<long long>(age.count()));
+            text += line;
+            text += site.type;
+            text += '\n';
+            for (const auto& frame : site.frames) {
+                text += "    ";
+                text += frame;
+                text += '\n';
+            }
+        }
+        return text;
+    }
+
+private:
+    static constexpr int kMaxFrames = 16;
+    // `Register` itself
+    static constexpr int kSkippedFrames = 1;
+    static constexpr size_t kShards = 64;
+
+    struct Entry {
+        std::string_view type;
+        size_t bytes;
+        CountsFunction counts;
+        std::chrono::steady_clock::time_point created;
+        std::array<void*, kMaxFrames> frames = {};
+        int depth = 0;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<const void*, Entry> entries;
+    };
+
+    // Not freed at exit: a `SharedPtr` held by a static of another translation unit
+    // unregisters its block whenever that static is destroyed, possibly after this one
+    static std::array<Shard, kShards>& Shards() {
+        static auto* shards = new std::array<Shard, kShards>();
+        return *shards;
+    }
+
+    static Shard& GetShard(const void* block) {
+        // Blocks are at least 8-byte aligned
+        return Shards()[(reinterpret_cast<uintptr_t>(block) >> 3) % kShards];
+    }
+
+    static std::vector<std::string> Symbolize(const std::vector<void*>& frames) {
+        std::vector<std::string> names;
+#ifdef SMART_PTR_HAS_BACKTRACE
+        char** symbols = backtrace_symbols(frames.data(), frames.size());
+        if (symbols) {
+            names.assign(symbols, symbols + frames.size());
+            std::free(symbols);
+            return names;
+        }
+#endif
+        char name[32];
+        for (void* frame : frames) {
+            std::snprintf(name, sizeof(name), "%p", frame);
+            names.push_back(name);
+        }
+        return names;
+    }
+
+    static inline std::atomic<size_t> sample_rate = 1;
+};
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <type_traits>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Threading models: how a single reference count is stored and updated
+
+struct SingleThreaded {
+    using Count = size_t;
+
+    static void Increment(Count& count) {
+        ++count;
+    }
+
+    // Returns the new value
+    static size_t Decrement(Count& count) {
+        return --count;
+    }
+
+    static bool IncrementIfNonZero(Count& count) {
+        if (count == 0) {
+            return false;
+        }
+        ++count;
+        return true;
+    }
+
+    static size_t Load(const Count& count) {
+        return count;
+    }
+
+    static size_t LoadAcquire(const Count& count) {
+        return count;
+    }
+};
+
+struct MultiThreaded {
+    using Count = std::atomic<size_t>;
+
+    static void Increment(Count& count) {
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Returns the new value
+    static size_t Decrement(Count& count) {
+        return count.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    }
+
+    static bool IncrementIfNonZero(Count& count) {
+        size_t value = count.load(std::memory_order_relaxed);
+        while (value != 0) {
+            if (count.compare_exchange_weak(value, value + 1, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static size_t Load(const Count& count) {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    // Also sees the writes of the threads that dropped the count to its value
+    static size_t LoadAcquire(const Count& count) {
+        return count.load(std::memory_order_acquire);
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Counters kept in control blocks
+
+// Strong references only, `WeakPtr` can not be created
+template <class Threading>
+class StrongCounter {
+public:
+    void IncreaseStrong() {
+        Threading::Increment(strong_);
+    }
+
+    bool TryIncreaseStrong() {
+        return Threading::IncrementIfNonZero(strong_);
+    }
+
+    // Returns true when the last strong reference is gone
+    bool DecreaseStrong() {
+        return Threading::Decrement(strong_) == 0;
+    }
+
+    size_t GetStrong() const {
+        return Threading::Load(strong_);
+    }
+
+    size_t GetWeak() const {
+        return 0;
+    }
+
+private:
+    typename Threading::Count strong_{1};
+};
+
+// `weak_` holds one extra reference on behalf of all strong ones,
+// so the block is released exactly once without reading both counters
+template <class Threading>
+class StrongWeakCounter : public StrongCounter<Threading> {
+public:
+    void IncreaseWeak() {
+        Threading::Increment(weak_);
+    }
+
+    // Returns true when the block is not referenced anymore
+    bool DecreaseWeak() {
+        return Threading::Decrement(weak_) == 0;
+    }
+
+    // Drops the reference held on behalf of strong ones once they are all gone.
+    // References are only copied from existing ones: with no strong ones and a count of one,
+    // nobody else can reach the block and the count is dropped without an atomic update.
+    bool DecreaseWeakOnExpiry() {
+        return Threading::LoadAcquire(weak_) == 1 || DecreaseWeak();
+    }
+
+    size_t GetWeak() const {
+        return Threading::Load(weak_) - (this->GetStrong() != 0);
+    }
+
+private:
+    typename Threading::Count weak_{1};
+};
+
+// Both counts in a single 64-bit word: strong in the low half, weak in the high one.
+// Together with the vptr it keeps the block header at 16 bytes.
+// Like `StrongWeakCounter`, weak count holds one extra reference on behalf of all strong ones.
+class PackedCounter {
+public:
+    void IncreaseStrong() {
+        CheckOverflow(word_.fetch_add(kStrongOne, std::memory_order_relaxed) & kHalfMask);
+    }
+
+    bool TryIncreaseStrong() {
+        uint64_t word = word_.load(std::memory_order_relaxed);
+        while ((word & kHalfMask) != 0) {
+            CheckOverflow(word & kHalfMask);
+            if (word_.compare_exchange_weak(word, word + kStrongOne, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns true when the last strong reference is gone.
+    // The sole strong reference without weak ones can not be shared anymore: the block is
+    // released without an atomic update, the counts keep their last value.
+    bool DecreaseStrong() {
+        if (word_.load(std::memory_order_acquire) == (kStrongOne | kWeakOne)) {
+            return true;
+        }
+        return (word_.fetch_sub(kStrongOne, std::memory_order_acq_rel) & kHalfMask) == 1;
+    }
+
+    size_t GetStrong() const {
+        return word_.load(std::memory_order_relaxed) & kHalfMask;
+    }
+
+    void IncreaseWeak() {
+        CheckOverflow(word_.fetch_add(kWeakOne, std::memory_order_relaxed) >> kHalfBits);
+    }
+
+    // Returns true when the block is not referenced anymore
+    bool DecreaseWeak() {
+        return (word_.fetch_sub(kWeakOne, std::memory_order_acq_rel) >> kHalfBits) == 1;
+    }
+
+    // See `StrongWeakCounter::DecreaseWeakOnExpiry()`
+    bool DecreaseWeakOnExpiry() {
+        return (word_.load(std::memory_order_acquire) >> kHalfBits) == 1 || DecreaseWeak();
+    }
+
+    size_t GetWeak() const {
+        uint64_t word = word_.load(std::memory_order_relaxed);
+        return (word >> kHalfBits) - ((word & kHalfMask) != 0);
+    }
+
+private:
+    static constexpr int kHalfBits = 32;
+    static constexpr uint64_t kHalfMask = (uint64_t{1} << kHalfBits) - 1;
+    static constexpr uint64_t kStrongOne = 1;
+    static constexpr uint64_t kWeakOne = uint64_t{1} << kHalfBits;
+
+    // A half would carry into its neighbour, counts can not be trusted anymore
+    static void CheckOverflow(uint64_t previous) {
+        if (previous == kHalfMask) {
+            std::terminate();
+        }
+    }
+
+    std::atomic<uint64_t> word_ = kStrongOne | kWeakOne;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Policies for `SharedPtr<T, Policy>`
+// A policy provides `Counter` type and `kWeak` flag
+
+template <class Threading, bool WithWeak = true>
+struct SharedPolicy {
+    using Counter =
+        std::conditional_t<WithWeak, StrongWeakCounter<Threading>, StrongCounter<Threading>>;
+
+    static constexpr bool kWeak = WithWeak;
+};
+
+using DefaultSharedPolicy = SharedPolicy<MultiThreaded>;
+
+// Thread-safe with weak references and a 16-byte block header
+struct PackedSharedPolicy {
+    using Counter = PackedCounter;
+
+    static constexpr bool kWeak = true;
+};
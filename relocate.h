@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Trivial relocation: moving an object to new memory and destroying the source in one step
+// comes down to copying its bytes, if the object holds no pointers into itself and is not
+// registered anywhere by address. Every smart pointer here qualifies, so containers that
+// grow by relocation can move a buffer of them with one `memcpy`, without touching a
+// single control block.
+
+// Specialized next to each pointer type
+template <class T>
+struct IsTriviallyRelocatable : std::is_trivially_copyable<T> {};
+
+template <class T>
+inline constexpr bool kTriviallyRelocatable = IsTriviallyRelocatable<T>::value;
+
+// Moves `count` objects from `source` to uninitialized memory at `destination` and ends the
+// lifetime of the sources. The ranges must not overlap. Returns the end of the destination.
+template <class T>
+T* RelocateN(T* source, size_t count, T* destination) {
+    if constexpr (kTriviallyRelocatable<T>) {
+        if (count != 0) {
+            std::memcpy(static_cast<void*>(destination), static_cast<const void*>(source),
+                        count * sizeof(T));
+        }
+        return destination + count;
+    } else {
+        T* end = std::uninitialized_move_n(source, count, destination).second;
+        std::destroy_n(source, count);
+        return end;
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Queue of items handed back to the thread they belong to. Other threads push items, the
+// owner thread takes them at its drain points and when it exits; after that `Push()` fails
+// and the caller deals with the item itself. Queues are reference counted by their thread
+// and by the items that point to them, as items may outlive the thread.
+//
+// `Item` links items through a `next_` member and handles a returned item in a static
+// `OnReturned(Item*)`, called on the owner thread. It befriends the queue for both.
+
+template <class Item>
+class ThreadReturnQueue {
+public:
+    // Queue of the calling thread, created on first use.
+    // Null once the thread has started exiting: items created by later thread-local
+    // destructors belong to no thread.
+    static ThreadReturnQueue* Current() {
+        if (!current && !exited) {
+            current = new ThreadReturnQueue();
+            static thread_local Closer closer{current};
+        }
+        return current;
+    }
+
+    static bool IsCurrent(const ThreadReturnQueue* queue) {
+        return queue && queue == current;
+    }
+
+    // Take the items handed back to the calling thread.
+    // Call it at safe points of long-living threads.
+    static void DrainCurrent() {
+        if (current) {
+            current->Drain();
+        }
+    }
+
+    void Ref() {
+        refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Unref() {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    // Returns false if the owner thread has already exited
+    bool Push(Item* item) {
+        Item* head = head_.load(std::memory_order_acquire);
+        do {
+            if (head == kClosed) {
+                return false;
+            }
+            item->next_ = head;
+        } while (!head_.compare_exchange_weak(head, item, std::memory_order_acq_rel));
+        return true;
+    }
+
+    void Drain() {
+        if (head_.load(std::memory_order_relaxed) != nullptr) {
+            Process(head_.exchange(nullptr, std::memory_order_acq_rel));
+        }
+    }
+
+private:
+    struct Closer {
+        ~Closer() {
+            // Thread-local destructors that run later must not reach the freed queue
+            current = nullptr;
+            exited = true;
+            queue->Close();
+            queue->Unref();
+        }
+
+        ThreadReturnQueue* queue;
+    };
+
+    void Close() {
+        Process(head_.exchange(kClosed, std::memory_order_acq_rel));
+    }
+
+    static void Process(Item* list) {
+        while (list) {
+            // The item may be gone once handled
+            Item* item = list;
+            list = list->next_;
+            Item::OnReturned(item);
+        }
+    }
+
+    static inline Item* const kClosed = reinterpret_cast<Item*>(1);
+
+    static inline thread_local ThreadReturnQueue* current = nullptr;
+    static inline thread_local bool exited = false;
+
+    std::atomic<Item*> head_ = nullptr;
+    std::atomic<size_t> refs_ = 1;
+};
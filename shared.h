@@ -1,15 +1,19 @@
 #pragma once
 
 #include "sw_fwd.h"  // Forward declaration
+#include "unique.h"
 
 #include <cstddef>  // std::nullptr_t
 #include <utility>
 #include <memory>
 
 // https://en.cppreference.com/w/cpp/memory/shared_ptr
-template <typename T>
+template <typename T, typename Policy>
 class SharedPtr {
 public:
+    // `T` itself for objects, `U` for arrays `U[]` and `U[N]`
+    using ElementType = std::remove_extent_t<T>;
+
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Constructors
 
@@ -19,8 +23,8 @@ public:
     SharedPtr(std::nullptr_t) {
     }
 
-    explicit SharedPtr(T* ptr) {
-        block_ = new ControlBlockPtr<T>(ptr);
+    explicit SharedPtr(ElementType* ptr) {
+        block_ = new ControlBlockPtr<T, Policy>(ptr);
         ptr_ = ptr;
         if constexpr (std::is_base_of_v<EnableSharedFromThisBase, T>) {
             ptr_->ptr_ = ptr;
@@ -30,7 +34,7 @@ public:
 
     template <class U>
     explicit SharedPtr(U* ptr) {
-        block_ = new ControlBlockPtr<U>(ptr);
+        block_ = new ControlBlockPtr<Owned<U>, Policy>(ptr);
         ptr_ = static_cast<U*>(ptr);
         if constexpr (std::is_base_of_v<EnableSharedFromThisBase, U>) {
             ptr_->ptr_ = static_cast<U*>(ptr);
@@ -38,7 +42,35 @@ public:
         }
     }
 
-    SharedPtr(T* ptr, ControlBlockBase* block) : ptr_(ptr), block_(block) {
+    // `deleter(ptr)` is called instead of `delete` when the last owner is gone
+    template <class U, class D>
+        requires std::is_invocable_v<D&, U*>
+    SharedPtr(U* ptr, D deleter) {
+        block_ = new ControlBlockDeleter<Owned<U>, D, Policy>(ptr, std::move(deleter));
+        ptr_ = ptr;
+        if constexpr (std::is_base_of_v<EnableSharedFromThisBase, U>) {
+            ptr_->ptr_ = ptr;
+            ptr_->block_ = block_;
+        }
+    }
+
+    // Adopts both the pointer and the deleter
+    template <class U, class D>
+    SharedPtr(UniquePtr<U, D>&& other) {
+        if (!other) {
+            return;
+        }
+        auto* ptr = other.Get();
+        block_ = new ControlBlockDeleter<U, D, Policy>(ptr, std::move(other.GetDeleter()));
+        other.Release();
+        ptr_ = ptr;
+        if constexpr (std::is_base_of_v<EnableSharedFromThisBase, U>) {
+            ptr_->ptr_ = ptr;
+            ptr_->block_ = block_;
+        }
+    }
+
+    SharedPtr(ElementType* ptr, ControlBlockBase<Policy>* block) : ptr_(ptr), block_(block) {
         if constexpr (std::is_base_of_v<EnableSharedFromThisBase, T>) {
             ptr_->ptr_ = ptr;
             ptr_->block_ = block_;
@@ -46,7 +78,7 @@ public:
     }
 
     template <class X>
-    SharedPtr(const SharedPtr<X>& other) {
+    SharedPtr(const SharedPtr<X, Policy>& other) {
         block_ = other.block_;
         if (block_) {
             block_->IncreaseStrong();
@@ -55,14 +87,14 @@ public:
     }
 
     template <class X>
-    SharedPtr(SharedPtr<X>&& other) {
+    SharedPtr(SharedPtr<X, Policy>&& other) noexcept {
         block_ = other.block_;
         ptr_ = other.ptr_;
         other.block_ = nullptr;
         other.ptr_ = nullptr;
     }
 
-    SharedPtr(const SharedPtr<T>& other) {
+    SharedPtr(const SharedPtr<T, Policy>& other) {
         block_ = other.block_;
         if (block_) {
             block_->IncreaseStrong();
@@ -70,7 +102,7 @@ public:
         ptr_ = other.ptr_;
     }
 
-    SharedPtr(SharedPtr<T>&& other) {
+    SharedPtr(SharedPtr<T, Policy>&& other) noexcept {
         block_ = other.block_;
         ptr_ = other.ptr_;
         other.block_ = nullptr;
@@ -80,7 +112,7 @@ public:
     // Aliasing constructor
     // #8 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
     template <typename Y>
-    SharedPtr(const SharedPtr<Y>& other, T* ptr) {
+    SharedPtr(const SharedPtr<Y, Policy>& other, ElementType* ptr) {
         block_ = other.block_;
         if (block_) {
             block_->IncreaseStrong();
@@ -90,14 +122,11 @@ public:
 
     // Promote `WeakPtr`
     // #11 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
-    explicit SharedPtr(const WeakPtr<T>& other) {
-        if (other.Expired()) {
+    explicit SharedPtr(const WeakPtr<T, Policy>& other) {
+        if (!other.block_ || !other.block_->TryIncreaseStrong()) {
             throw BadWeakPtr();
         }
         block_ = other.block_;
-        if (block_) {
-            block_->IncreaseStrong();
-        }
         ptr_ = other.ptr_;
     }
 
@@ -105,42 +134,38 @@ public:
     // `operator=`-s
 
     template <class X>
-    SharedPtr& operator=(const SharedPtr<X>& other) {
-        if (block_) {
-            block_->DecreaseStrong();
+    SharedPtr& operator=(const SharedPtr<X, Policy>& other) {
+        if (other.block_) {
+            other.block_->IncreaseStrong();
         }
-        block_ = other.block_;
-        if (block_) {
-            block_->IncreaseStrong();
-        }
-        ptr_ = other.ptr_;
+        Replace(other.block_, other.ptr_);
         return *this;
     }
 
     template <class X>
-    SharedPtr& operator=(SharedPtr<X>&& other) {
-        if (block_) {
-            block_->DecreaseStrong();
-        }
-        block_ = other.block_;
-        ptr_ = other.ptr_;
-        other.block_ = nullptr;
-        other.ptr_ = nullptr;
+    SharedPtr& operator=(SharedPtr<X, Policy>&& other) noexcept {
+        Replace(std::exchange(other.block_, nullptr), std::exchange(other.ptr_, nullptr));
         return *this;
     }
 
-    SharedPtr& operator=(const SharedPtr<T>& other) {
+    SharedPtr& operator=(const SharedPtr<T, Policy>& other) {
         if (this == &other) {
             return *this;
         }
-        if (block_) {
-            block_->DecreaseStrong();
+        if (other.block_) {
+            other.block_->IncreaseStrong();
         }
-        block_ = other.block_;
-        if (block_) {
-            block_->IncreaseStrong();
+        Replace(other.block_, other.ptr_);
+        return *this;
+    }
+
+    // Not a template, so it is a real move assignment: the template above would release the
+    // block before taking it over on self-move
+    SharedPtr& operator=(SharedPtr<T, Policy>&& other) noexcept {
+        if (this == &other) {
+            return *this;
         }
-        ptr_ = other.ptr_;
+        Replace(std::exchange(other.block_, nullptr), std::exchange(other.ptr_, nullptr));
         return *this;
     }
 
@@ -157,27 +182,25 @@ public:
     // Modifiers
 
     void Reset() {
-        if (block_) {
-            block_->DecreaseStrong();
-        }
-        block_ = nullptr;
-        ptr_ = nullptr;
+        Replace(nullptr, nullptr);
     }
 
-    void Reset(T* ptr) {
-        Reset();
-        block_ = new ControlBlockPtr<T>(ptr);
-        ptr_ = ptr;
+    void Reset(ElementType* ptr) {
+        Replace(new ControlBlockPtr<T, Policy>(ptr), ptr);
     }
 
     template <class U>
     void Reset(U* ptr) {
-        Reset();
-        block_ = new ControlBlockPtr<U>(ptr);
-        ptr_ = ptr;
+        Replace(new ControlBlockPtr<Owned<U>, Policy>(ptr), ptr);
+    }
+
+    template <class U, class D>
+        requires std::is_invocable_v<D&, U*>
+    void Reset(U* ptr, D deleter) {
+        Replace(new ControlBlockDeleter<Owned<U>, D, Policy>(ptr, std::move(deleter)), ptr);
     }
 
-    void Swap(SharedPtr& other) {
+    void Swap(SharedPtr& other) noexcept {
         std::swap(block_, other.block_);
         std::swap(ptr_, other.ptr_);
     }
@@ -185,18 +208,22 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Observers
 
-    T* Get() const {
+    ElementType* Get() const {
         return ptr_;
     }
 
-    T& operator*() const {
+    ElementType& operator*() const {
         return *ptr_;
     }
 
-    T* operator->() const {
+    ElementType* operator->() const {
         return ptr_;
     }
 
+    ElementType& operator[](ptrdiff_t index) const {
+        return ptr_[index];
+    }
+
     size_t UseCount() const {
         if (!block_) {
             return 0;
@@ -208,58 +235,128 @@ public:
         return block_;
     }
 
-    ControlBlockBase* block_ = nullptr;
-    T* ptr_ = nullptr;
+    ControlBlockBase<Policy>* block_ = nullptr;
+    ElementType* ptr_ = nullptr;
+
+private:
+    // What a raw `U*` passed by the user points to: a single object or an array
+    template <class U>
+    using Owned = std::conditional_t<std::is_array_v<T>, U[], U>;
+
+    // Takes over a reference to `block`. The old one is released last: its object may own
+    // this pointer, as in `node->next.Reset()` breaking a cycle.
+    void Replace(ControlBlockBase<Policy>* block, ElementType* ptr) {
+        ControlBlockBase<Policy>* old = std::exchange(block_, block);
+        ptr_ = ptr;
+        if (old) {
+            old->DecreaseStrong();
+        }
+    }
 };
 
-template <typename T, typename U>
-inline bool operator==(const SharedPtr<T>& left, const SharedPtr<U>& right) {
+template <typename T, typename U, typename Policy>
+inline bool operator==(const SharedPtr<T, Policy>& left, const SharedPtr<U, Policy>& right) {
     return left.Get() == right.Get();
 }
 
 // Allocate memory only once
-template <typename T, typename... Args>
-SharedPtr<T> MakeShared(Args&&... args) {
-    ControlBlockArgs<T>* block = new ControlBlockArgs<T>(std::forward<Args>(args)...);
-    return SharedPtr<T>(block->Get(), block);
+template <typename T, typename Policy = DefaultSharedPolicy, typename... Args>
+    requires(!std::is_array_v<T>)
+SharedPtr<T, Policy> MakeShared(Args&&... args) {
+    auto* block = new ControlBlockArgs<T, Policy>(std::forward<Args>(args)...);
+    return SharedPtr<T, Policy>(block->Get(), block);
+}
+
+// Elements are value-initialized and stored right after the counters
+template <typename T, typename Policy = DefaultSharedPolicy>
+    requires std::is_unbounded_array_v<T>
+SharedPtr<T, Policy> MakeShared(size_t size) {
+    auto* block = ControlBlockArray<std::remove_extent_t<T>, Policy>::Create(size);
+    return SharedPtr<T, Policy>(block->Get(), block);
+}
+
+template <typename T, typename Policy = DefaultSharedPolicy>
+    requires std::is_bounded_array_v<T>
+SharedPtr<T, Policy> MakeShared() {
+    auto* block = ControlBlockArray<std::remove_extent_t<T>, Policy>::Create(std::extent_v<T>);
+    return SharedPtr<T, Policy>(block->Get(), block);
+}
+
+// Single allocation without zeroing: for buffers that are about to be overwritten
+template <typename T, typename Policy = DefaultSharedPolicy>
+    requires(!std::is_array_v<T>)
+SharedPtr<T, Policy> MakeSharedForOverwrite() {
+    auto* block = new ControlBlockArgs<T, Policy>(ForOverwriteTag());
+    return SharedPtr<T, Policy>(block->Get(), block);
+}
+
+template <typename T, typename Policy = DefaultSharedPolicy>
+    requires std::is_unbounded_array_v<T>
+SharedPtr<T, Policy> MakeSharedForOverwrite(size_t size) {
+    auto* block = ControlBlockArray<std::remove_extent_t<T>, Policy>::Create(size, ForOverwriteTag());
+    return SharedPtr<T, Policy>(block->Get(), block);
+}
+
+template <typename T, typename Policy = DefaultSharedPolicy>
+    requires std::is_bounded_array_v<T>
+SharedPtr<T, Policy> MakeSharedForOverwrite() {
+    auto* block = ControlBlockArray<std::remove_extent_t<T>, Policy>::Create(std::extent_v<T>,
+                                                                            ForOverwriteTag());
+    return SharedPtr<T, Policy>(block->Get(), block);
+}
+
+// Like `MakeShared`, but the block is allocated and freed by `alloc`
+template <typename T, typename Policy = DefaultSharedPolicy, typename Alloc, typename... Args>
+SharedPtr<T, Policy> AllocateShared(const Alloc& alloc, Args&&... args) {
+    using Block = ControlBlockAlloc<T, Alloc, Policy>;
+    using Traits = std::allocator_traits<typename Block::Allocator>;
+    typename Block::Allocator block_alloc(alloc);
+    Block* block = Traits::allocate(block_alloc, 1);
+    try {
+        new (block) Block(block_alloc, std::forward<Args>(args)...);
+    } catch (...) {
+        Traits::deallocate(block_alloc, block, 1);
+        throw;
+    }
+    return SharedPtr<T, Policy>(block->Get(), block);
 }
 
 // Look for usage examples in tests
-template <typename T>
+template <typename T, typename Policy>
 class EnableSharedFromThis : EnableSharedFromThisBase {
 public:
-    SharedPtr<T> SharedFromThis() {
-        SharedPtr<T> ptr(ptr_, block_);
+    SharedPtr<T, Policy> SharedFromThis() {
+        SharedPtr<T, Policy> ptr(ptr_, block_);
         if (block_) {
             block_->IncreaseStrong();
         }
         return ptr;
     }
 
-    SharedPtr<const T> SharedFromThis() const {
-        SharedPtr<const T> ptr(ptr_, block_);
+    SharedPtr<const T, Policy> SharedFromThis() const {
+        SharedPtr<const T, Policy> ptr(ptr_, block_);
         if (block_) {
             block_->IncreaseStrong();
         }
         return ptr;
     }
 
-    WeakPtr<T> WeakFromThis() noexcept {
-        WeakPtr<T> ptr(ptr_, block_);
+    WeakPtr<T, Policy> WeakFromThis() noexcept {
+        WeakPtr<T, Policy> ptr(ptr_, block_);
         if (block_) {
             block_->IncreaseWeak();
         }
         return ptr;
     }
 
-    WeakPtr<const T> WeakFromThis() const noexcept {
-        WeakPtr<const T> ptr(ptr_, block_);
+    WeakPtr<const T, Policy> WeakFromThis() const noexcept {
+        WeakPtr<const T, Policy> ptr(ptr_, block_);
         if (block_) {
             block_->IncreaseWeak();
         }
         return ptr;
     }
 
-    ControlBlockBase* block_ = nullptr;
+    ControlBlockBase<Policy>* block_ = nullptr;
     T* ptr_ = nullptr;
 };
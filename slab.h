@@ -0,0 +1,247 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Fixed-size slot allocator with per-thread caches.
+// A thread allocates from and frees to its own free list, including slots allocated by other
+// threads. When the list grows past `kMaxCached`, half of it overflows to the global lists,
+// which also feed threads that ran out of slots. Slabs are aligned to their size and start with
+// a header that keeps the slab's own global free list and its length: a slab whose slots are all
+// back on it goes to the system, one of them is kept as a spare.
+
+template <size_t Size, size_t Align = alignof(std::max_align_t)>
+class SlabPool {
+public:
+    static void* Allocate() {
+        ThreadCache& cache = LocalCache();
+        if (!cache.head) {
+            Refill(cache);
+        }
+        FreeSlot* slot = cache.head;
+        cache.head = slot->next;
+        --cache.count;
+        return slot;
+    }
+
+    static void Deallocate(void* pointer) {
+        ThreadCache& cache = LocalCache();
+        auto* slot = static_cast<FreeSlot*>(pointer);
+        slot->next = cache.head;
+        cache.head = slot;
+        if (++cache.count > kMaxCached) {
+            Overflow(cache, kMaxCached / 2);
+        }
+    }
+
+    // Give all slots cached by the calling thread back to the global lists
+    static void TrimCurrentThread() {
+        ThreadCache& cache = LocalCache();
+        Overflow(cache, cache.count);
+    }
+
+    // Give the spare slab back to the system
+    static void Trim() {
+        State& state = Global();
+        Slab* spare = nullptr;
+        {
+            std::lock_guard guard(state.mutex);
+            spare = std::exchange(state.spare, nullptr);
+            if (spare) {
+                --state.slabs;
+            }
+        }
+        if (spare) {
+            FreeSlab(spare);
+        }
+    }
+
+    static size_t SlabCount() {
+        State& state = Global();
+        std::lock_guard guard(state.mutex);
+        return state.slabs;
+    }
+
+private:
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    struct Slab {
+        // Links slabs with slots on their free list, and slabs to free after unlocking
+        Slab* prev;
+        Slab* next;
+        FreeSlot* free;
+        size_t free_count;
+    };
+
+    struct ThreadCache {
+        ~ThreadCache() {
+            Overflow(*this, count);
+        }
+
+        FreeSlot* head = nullptr;
+        size_t count = 0;
+    };
+
+    struct State {
+        std::mutex mutex;
+        // Slabs with at least one slot on their free list
+        Slab* partial = nullptr;
+        // A free slab kept to absorb alternating frees and refills
+        Slab* spare = nullptr;
+        size_t slabs = 0;
+    };
+
+    static constexpr size_t kSlotAlign = std::max(Align, alignof(FreeSlot));
+    static constexpr size_t kSlotSize =
+        (std::max(Size, sizeof(FreeSlot)) + kSlotAlign - 1) / kSlotAlign * kSlotAlign;
+    static constexpr size_t kSlabSize = 64 * 1024;
+    static constexpr size_t kHeaderSize = (sizeof(Slab) + kSlotAlign - 1) / kSlotAlign * kSlotAlign;
+    static constexpr size_t kSlotsPerSlab = (kSlabSize - kHeaderSize) / kSlotSize;
+    static constexpr size_t kMaxCached = 256;
+    static constexpr size_t kBatch = 64;
+
+    static_assert(kSlotAlign <= kSlabSize && kSlotsPerSlab > 0, "Slots do not fit into a slab");
+
+    // Leaked: thread caches of detached threads, and the nodes of the deferred reclaimer's
+    // thread, come back here after `main` has returned
+    static State& Global() {
+        static State* state = new State();
+        return *state;
+    }
+
+    static ThreadCache& LocalCache() {
+        static thread_local ThreadCache cache;
+        return cache;
+    }
+
+    static Slab* SlabOf(FreeSlot* slot) {
+        return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(slot) & ~(kSlabSize - 1));
+    }
+
+    static void FreeSlab(Slab* slab) {
+        ::operator delete(slab, std::align_val_t(kSlabSize));
+    }
+
+    static void Link(State& state, Slab* slab) {
+        slab->prev = nullptr;
+        slab->next = state.partial;
+        if (state.partial) {
+            state.partial->prev = slab;
+        }
+        state.partial = slab;
+    }
+
+    static void Unlink(State& state, Slab* slab) {
+        (slab->prev ? slab->prev->next : state.partial) = slab->next;
+        if (slab->next) {
+            slab->next->prev = slab->prev;
+        }
+    }
+
+    // Moves `count` slots from the thread cache to the free lists of their slabs.
+    // Slabs that become free are released after the mutex is dropped.
+    static void Overflow(ThreadCache& cache, size_t count) {
+        if (count == 0) {
+            return;
+        }
+        FreeSlot* slot = cache.head;
+        FreeSlot* last = slot;
+        for (size_t i = 1; i < count; ++i) {
+            last = last->next;
+        }
+        cache.head = last->next;
+        cache.count -= count;
+        last->next = nullptr;
+
+        State& state = Global();
+        Slab* released = nullptr;
+        {
+            std::lock_guard guard(state.mutex);
+            while (slot) {
+                FreeSlot* next = slot->next;
+                Slab* slab = SlabOf(slot);
+                if (slab->free_count == 0) {
+                    Link(state, slab);
+                }
+                slot->next = slab->free;
+                slab->free = slot;
+                if (++slab->free_count == kSlotsPerSlab) {
+                    Unlink(state, slab);
+                    if (!state.spare) {
+                        state.spare = slab;
+                    } else {
+                        slab->next = released;
+                        released = slab;
+                        --state.slabs;
+                    }
+                }
+                slot = next;
+            }
+        }
+        while (released) {
+            Slab* slab = released;
+            released = slab->next;
+            FreeSlab(slab);
+        }
+    }
+
+    static void Refill(ThreadCache& cache) {
+        State& state = Global();
+        Slab* slab = nullptr;
+        {
+            std::lock_guard guard(state.mutex);
+            while (state.partial && cache.count < kBatch) {
+                Slab* partial = state.partial;
+                while (partial->free && cache.count < kBatch) {
+                    FreeSlot* slot = partial->free;
+                    partial->free = slot->next;
+                    --partial->free_count;
+                    slot->next = cache.head;
+                    cache.head = slot;
+                    ++cache.count;
+                }
+                if (partial->free_count == 0) {
+                    Unlink(state, partial);
+                }
+            }
+            if (cache.head) {
+                return;
+            }
+            slab = std::exchange(state.spare, nullptr);
+        }
+        if (!slab) {
+            slab = static_cast<Slab*>(::operator new(kSlabSize, std::align_val_t(kSlabSize)));
+            std::lock_guard guard(state.mutex);
+            ++state.slabs;
+        }
+        // All slots go to the cache, the slab's own list starts empty
+        slab->free = nullptr;
+        slab->free_count = 0;
+        auto* slots = reinterpret_cast<char*>(slab) + kHeaderSize;
+        for (size_t i = kSlotsPerSlab; i > 0; --i) {
+            auto* slot = reinterpret_cast<FreeSlot*>(slots + (i - 1) * kSlotSize);
+            slot->next = cache.head;
+            cache.head = slot;
+        }
+        cache.count += kSlotsPerSlab;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Policy wrapper: `ControlBlockPtr` blocks of `SharedPtr<T, SlabBlocks<Policy>>` come from a
+// `SlabPool`. All of them have the same size whatever `T` is, so every type shares one pool.
+
+template <class Policy>
+struct SlabBlocks : Policy {
+    static constexpr bool kSlabBlocks = true;
+};
+
+template <class Policy>
+inline constexpr bool kUsesSlabBlocks = requires { requires Policy::kSlabBlocks; };
@@ -1,162 +1,449 @@
 #pragma once
 
+#include "affine.h"
+#include "compressed_pair.h"
+#include "deferred.h"
+#include "instrument.h"
+#include "iterative.h"
+#include "leaks.h"
+#include "policies.h"
+#include "relocate.h"
+#include "slab.h"
+
+#include <algorithm>
+#include <cstddef>
 #include <exception>
-
+#include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+
+// Derived blocks report themselves to the opt-in instrumentation and leak tracking:
+// `block` holds a `T` and takes `bytes` of memory
+#if defined(SMART_PTR_INSTRUMENT) || defined(SMART_PTR_TRACK_LEAKS)
+#define SMART_PTR_TRACK_BLOCK(block, T, bytes) (block)->template Track<T>(bytes)
+#else
+#define SMART_PTR_TRACK_BLOCK(block, T, bytes) ((void)0)
+#endif
+
+// Counters and their updates are not virtual, so copies and destruction of pointers inline.
+// Derived blocks only differ in how the object is destroyed and the block is deallocated,
+// which is dispatched once a counter drops to zero.
+template <class Policy = DefaultSharedPolicy>
 class ControlBlockBase {
 public:
-    virtual void IncreaseStrong() {
+    ControlBlockBase() {
+        if constexpr (requires { counter_.Bind(this, &Release); }) {
+            // Counters that may hit zero outside of `DecreaseStrong()`
+            counter_.Bind(this, &Release);
+        }
     }
 
-    virtual void DecreaseStrong() {
+    void IncreaseStrong() {
+        SMART_PTR_COUNT(type_, kIncreaseStrong, 1);
+        counter_.IncreaseStrong();
     }
 
-    virtual void IncreaseWeak() {
+    void DecreaseStrong() {
+        SMART_PTR_COUNT(type_, kDecreaseStrong, 1);
+        if (counter_.DecreaseStrong()) {
+            ReleaseStrong();
+        }
     }
 
-    virtual void DecreaseWeak() {
+    // Increase strong counter only if it has not dropped to zero yet.
+    // Used to promote `WeakPtr` without racing with the last `SharedPtr`.
+    bool TryIncreaseStrong() {
+        bool promoted = counter_.TryIncreaseStrong();
+        SMART_PTR_COUNT(type_, kWeakPromotion, promoted);
+        SMART_PTR_COUNT(type_, kFailedWeakPromotion, !promoted);
+        return promoted;
     }
 
-    virtual void OnZeroStrong() {
+    void IncreaseWeak() {
+        if constexpr (Policy::kWeak) {
+            counter_.IncreaseWeak();
+        }
     }
 
-    virtual void OnZeroWeak() {
+    void DecreaseWeak() {
+        if constexpr (Policy::kWeak) {
+            if (counter_.DecreaseWeak()) {
+                Free();
+            }
+        }
     }
 
-    virtual size_t GetStrong() {
+    // Last strong reference is gone. The destruction wrappers of the policy compose:
+    // the block goes to the reclaimer first, then to its owner thread, then through the
+    // iterative teardown, each stage handing it on to the next enabled one.
+    void ReleaseStrong() {
+        ReleaseStage<Stage::kDeferred>();
     }
 
-    virtual size_t GetWeak() {
-        return 0;
+    size_t GetStrong() const {
+        return counter_.GetStrong();
     }
 
-    virtual ~ControlBlockBase() {
+    size_t GetWeak() const {
+        return counter_.GetWeak();
     }
-};
 
-template <class T>
-class ControlBlockPtr : public ControlBlockBase {
-public:
-    ControlBlockPtr(T* ptr) : ptr_(ptr), strong_(1), weak_(0) {
+    // Destroy the object
+    virtual void OnZeroStrong() = 0;
+
+    // Deallocate the block
+    virtual void OnZeroWeak() = 0;
+
+    virtual ~ControlBlockBase() = default;
+
+#if defined(SMART_PTR_INSTRUMENT) || defined(SMART_PTR_TRACK_LEAKS)
+    // Called through `SMART_PTR_TRACK_BLOCK` once the object is constructed
+    template <class T>
+    void Track(size_t bytes) {
+#ifdef SMART_PTR_INSTRUMENT
+        type_ = Instrumentation::TypeId<T>();
+        bytes_ = bytes;
+        SMART_PTR_COUNT(type_, kAllocation, 1);
+        SMART_PTR_COUNT(type_, kAllocatedBytes, bytes_);
+#endif
+#ifdef SMART_PTR_TRACK_LEAKS
+        if (LeakTracker::ShouldSample()) {
+            leak_tracked_ = true;
+            LeakTracker::Register(this, TypeName<T>(), bytes, &GetCounts);
+        }
+#endif
+    }
+#endif
+
+private:
+    enum class Stage {
+        kDeferred,
+        kOwnerThread,
+        kIterative,
+        kDestroy,
+    };
+
+    template <Stage kStage>
+    static void ReleaseFrom(void* block) {
+        static_cast<ControlBlockBase*>(block)->template ReleaseStage<kStage>();
+    }
+
+    template <Stage kStage>
+    void ReleaseStage() {
+        if constexpr (kStage == Stage::kDeferred && kDefersDestruction<Policy>) {
+            DeferredReclaimer::Global().Retire(this, &ReleaseFrom<Stage::kOwnerThread>);
+        } else if constexpr (kStage == Stage::kOwnerThread && kDestroysOnOwnerThread<Policy>) {
+            counter_.Release(this, &ReleaseFrom<Stage::kIterative>);
+        } else if constexpr (kStage == Stage::kIterative && kDestroysIteratively<Policy>) {
+            IterativeTeardown::Destroy(this, &ReleaseFrom<Stage::kDestroy>);
+        } else if constexpr (kStage == Stage::kDestroy) {
+            DestroyAndRelease();
+        } else {
+            ReleaseStage<static_cast<Stage>(static_cast<int>(kStage) + 1)>();
+        }
     }
 
-    void IncreaseStrong() override {
-        ++strong_;
+    static void Release(void* block) {
+        static_cast<ControlBlockBase*>(block)->ReleaseStrong();
     }
 
-    void DecreaseStrong() override {
-        --strong_;
+    void DestroyAndRelease() {
         OnZeroStrong();
+        if constexpr (Policy::kWeak) {
+            if (counter_.DecreaseWeakOnExpiry()) {
+                Free();
+            }
+        } else {
+            Free();
+        }
+    }
+
+    void Free() {
+#ifdef SMART_PTR_INSTRUMENT
+        if (bytes_) {
+            SMART_PTR_COUNT(type_, kFree, 1);
+            SMART_PTR_COUNT(type_, kFreedBytes, bytes_);
+        }
+#endif
+#ifdef SMART_PTR_TRACK_LEAKS
+        if (leak_tracked_) {
+            LeakTracker::Unregister(this);
+        }
+#endif
         OnZeroWeak();
     }
 
-    void IncreaseWeak() override {
-        ++weak_;
+#ifdef SMART_PTR_TRACK_LEAKS
+    static LeakCounts GetCounts(const void* block) {
+        auto* self = static_cast<const ControlBlockBase*>(block);
+        return {self->GetStrong(), self->GetWeak()};
     }
+#endif
+
+    typename Policy::Counter counter_;
+#ifdef SMART_PTR_INSTRUMENT
+    uint32_t type_ = 0;
+    size_t bytes_ = 0;
+#endif
+#ifdef SMART_PTR_TRACK_LEAKS
+    bool leak_tracked_ = false;
+#endif
+};
 
-    void DecreaseWeak() override {
-        --weak_;
-        OnZeroWeak();
+template <class T, class Policy = DefaultSharedPolicy>
+class ControlBlockPtr : public ControlBlockBase<Policy> {
+public:
+    using ElementType = std::remove_extent_t<T>;
+
+    ControlBlockPtr(ElementType* ptr) : ptr_(ptr) {
+        // Arrays from `new[]` are accounted as a single element
+        SMART_PTR_TRACK_BLOCK(this, ElementType, sizeof(*this) + sizeof(ElementType));
     }
 
-    void OnZeroStrong() override {
-        if (strong_ == 0) {
-            delete ptr_;
-            ptr_ = nullptr;
+    static void* operator new(size_t size) {
+        if constexpr (kUsesSlabBlocks<Policy>) {
+            return SlabPool<sizeof(ControlBlockPtr), alignof(ControlBlockPtr)>::Allocate();
+        } else {
+            return ::operator new(size);
         }
     }
 
-    void OnZeroWeak() override {
-        if (strong_ + weak_ == 0) {
-            delete this;
+    static void operator delete(void* pointer) {
+        if constexpr (kUsesSlabBlocks<Policy>) {
+            SlabPool<sizeof(ControlBlockPtr), alignof(ControlBlockPtr)>::Deallocate(pointer);
+        } else {
+            ::operator delete(pointer);
         }
     }
 
-    size_t GetStrong() override {
-        return strong_;
+    void OnZeroStrong() override {
+        Delete();
+        ptr_ = nullptr;
     }
 
-    size_t GetWeak() override {
-        return weak_;
+    void OnZeroWeak() override {
+        delete this;
     }
 
     ~ControlBlockPtr() override {
         if (ptr_) {
+            Delete();
+        }
+    }
+
+    ElementType* ptr_;
+
+private:
+    void Delete() {
+        if constexpr (std::is_array_v<T>) {
+            delete[] ptr_;
+        } else {
             delete ptr_;
         }
     }
+};
+
+// Object is released by a user-provided deleter.
+// Stateless deleters take no space thanks to `CompressedPair`.
+template <class T, class D, class Policy = DefaultSharedPolicy>
+class ControlBlockDeleter : public ControlBlockBase<Policy> {
+public:
+    using ElementType = std::remove_extent_t<T>;
+
+    ControlBlockDeleter(ElementType* ptr, D deleter) : pair_(ptr, std::move(deleter)) {
+        SMART_PTR_TRACK_BLOCK(this, ElementType, sizeof(*this) + sizeof(ElementType));
+    }
+
+    void OnZeroStrong() override {
+        pair_.GetSecond()(pair_.GetFirst());
+        pair_.GetFirst() = nullptr;
+    }
 
-    T* ptr_;
-    size_t strong_;
-    size_t weak_;
+    void OnZeroWeak() override {
+        delete this;
+    }
+
+    ~ControlBlockDeleter() override = default;
+
+private:
+    CompressedPair<ElementType*, D> pair_;
 };
 
-template <class T>
-class ControlBlockArgs : public ControlBlockBase {
+// Requests default-initialization of the object, which leaves trivial types uninitialized
+struct ForOverwriteTag {};
+
+template <class T, class Policy = DefaultSharedPolicy>
+class ControlBlockArgs : public ControlBlockBase<Policy> {
 public:
     template <class... Args>
-    ControlBlockArgs(Args&&... args) : strong_(1), weak_(0) {
+    ControlBlockArgs(Args&&... args) {
         new (&holder) T(std::forward<Args>(args)...);
+        SMART_PTR_TRACK_BLOCK(this, T, sizeof(ControlBlockArgs));
     }
 
-    void IncreaseStrong() override {
-        ++strong_;
+    ControlBlockArgs(ForOverwriteTag) {
+        new (&holder) T;
+        SMART_PTR_TRACK_BLOCK(this, T, sizeof(ControlBlockArgs));
     }
 
-    void DecreaseStrong() override {
-        --strong_;
-        OnZeroStrong();
-        OnZeroWeak();
+    void OnZeroStrong() override {
+        Get()->~T();
     }
 
-    void IncreaseWeak() override {
-        ++weak_;
+    void OnZeroWeak() override {
+        delete this;
     }
 
-    void DecreaseWeak() override {
-        --weak_;
-        OnZeroWeak();
+    T* Get() {
+        return reinterpret_cast<T*>(&holder);
+    }
+
+    ~ControlBlockArgs() override = default;
+
+    alignas(T) char holder[sizeof(T)];
+};
+
+// Array of `T` stored right after the block header, in the same allocation
+template <class T, class Policy = DefaultSharedPolicy>
+class ControlBlockArray : public ControlBlockBase<Policy> {
+public:
+    // Value-initializes elements
+    static ControlBlockArray* Create(size_t size) {
+        return Create(size, [](T* element) { new (element) T(); });
+    }
+
+    // Default-initializes elements
+    static ControlBlockArray* Create(size_t size, ForOverwriteTag) {
+        return Create(size, [](T* element) { new (element) T; });
     }
 
     void OnZeroStrong() override {
-        if (strong_ == 0) {
-            Get()->~T();
-        }
+        Destroy(size_);
     }
 
     void OnZeroWeak() override {
-        if (strong_ + weak_ == 0) {
-            delete this;
-        }
+        this->~ControlBlockArray();
+        ::operator delete(this, std::align_val_t(kAlign));
     }
 
     T* Get() {
-        return reinterpret_cast<T*>(&holder);
+        return reinterpret_cast<T*>(reinterpret_cast<char*>(this) + Offset());
     }
 
-    size_t GetStrong() override {
-        return strong_;
+    size_t Size() const {
+        return size_;
     }
 
-    size_t GetWeak() override {
-        return weak_;
+    ~ControlBlockArray() override = default;
+
+private:
+    static constexpr size_t kAlign = std::max(alignof(ControlBlockBase<Policy>), alignof(T));
+
+    // Elements start after the header, aligned for `T`
+    static constexpr size_t Offset() {
+        return (sizeof(ControlBlockArray) + alignof(T) - 1) / alignof(T) * alignof(T);
     }
 
-    ~ControlBlockArgs() override = default;
+    explicit ControlBlockArray(size_t size) : size_(size) {
+    }
 
-    size_t strong_;
-    size_t weak_;
-    alignas(T) char holder[sizeof(T)];
+    template <class Init>
+    static ControlBlockArray* Create(size_t size, Init init) {
+        if (size > (std::numeric_limits<size_t>::max() - Offset()) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        void* memory = ::operator new(Offset() + size * sizeof(T), std::align_val_t(kAlign));
+        auto* block = new (memory) ControlBlockArray(size);
+        size_t constructed = 0;
+        try {
+            for (; constructed < size; ++constructed) {
+                init(block->Get() + constructed);
+            }
+        } catch (...) {
+            block->Destroy(constructed);
+            block->OnZeroWeak();
+            throw;
+        }
+        SMART_PTR_TRACK_BLOCK(block, T, Offset() + size * sizeof(T));
+        return block;
+    }
+
+    void Destroy(size_t count) {
+        for (size_t i = count; i > 0; --i) {
+            Get()[i - 1].~T();
+        }
+    }
+
+    size_t size_;
+};
+
+// Object and block allocated by `Alloc`, the allocator is kept for deallocation.
+// Stateless allocators take no space thanks to `CompressedPair`.
+template <class T, class Alloc, class Policy = DefaultSharedPolicy>
+class ControlBlockAlloc : public ControlBlockBase<Policy> {
+public:
+    using Allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<ControlBlockAlloc>;
+
+    template <class... Args>
+    ControlBlockAlloc(const Allocator& alloc, Args&&... args) : pair_(alloc, Storage()) {
+        ObjectAllocator object_alloc(pair_.GetFirst());
+        std::allocator_traits<ObjectAllocator>::construct(object_alloc, Get(),
+                                                          std::forward<Args>(args)...);
+        SMART_PTR_TRACK_BLOCK(this, T, sizeof(ControlBlockAlloc));
+    }
+
+    void OnZeroStrong() override {
+        ObjectAllocator object_alloc(pair_.GetFirst());
+        std::allocator_traits<ObjectAllocator>::destroy(object_alloc, Get());
+    }
+
+    void OnZeroWeak() override {
+        Allocator alloc(pair_.GetFirst());
+        this->~ControlBlockAlloc();
+        std::allocator_traits<Allocator>::deallocate(alloc, this, 1);
+    }
+
+    T* Get() {
+        return reinterpret_cast<T*>(&pair_.GetSecond().holder);
+    }
+
+    ~ControlBlockAlloc() override = default;
+
+private:
+    using ObjectAllocator =
+        typename std::allocator_traits<Alloc>::template rebind_alloc<std::remove_cv_t<T>>;
+
+    // Raw bytes for the object, which is constructed in place later
+    struct Storage {
+        Storage() {
+        }
+
+        Storage(Storage&&) {
+        }
+
+        alignas(T) char holder[sizeof(T)];
+    };
+
+    CompressedPair<Allocator, Storage> pair_;
 };
 
 class BadWeakPtr : public std::exception {};
 
 class EnableSharedFromThisBase {};
 
-template <class T>
+template <class T, class Policy = DefaultSharedPolicy>
 class EnableSharedFromThis;
 
-template <typename T>
+template <typename T, typename Policy = DefaultSharedPolicy>
 class SharedPtr;
 
-template <typename T>
+template <typename T, typename Policy = DefaultSharedPolicy>
 class WeakPtr;
+
+// A block pointer and an object pointer, nothing refers back to them
+template <typename T, typename Policy>
+struct IsTriviallyRelocatable<SharedPtr<T, Policy>> : std::true_type {};
+
+template <typename T, typename Policy>
+struct IsTriviallyRelocatable<WeakPtr<T, Policy>> : std::true_type {};
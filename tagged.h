@@ -0,0 +1,354 @@
+#pragma once
+
+#include "intrusive.h"
+#include "shared.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>  // std::nullptr_t
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Pointers carrying a few flag bits inside the pointer word, for links of lock-free structures
+// and compact nodes that would otherwise spend a whole word per edge on them.
+//
+// The low bits come free with alignment: up to 3 bits, as many as the alignment of the
+// pointee allows. On x86-64 the top 16 bits of user-space addresses are zero as well and can
+// be opted into with `kHighBits = 16` (not with 5-level paging and addresses above 2^47).
+// A tag is a number below `MaxTag() + 1`: the low bits of the word hold its lowest bits,
+// the high bits of the word the rest. A larger tag throws `std::invalid_argument` rather than
+// spilling into the address. Every path that follows the pointer strips the tag.
+
+#if defined(__x86_64__) || defined(_M_X64)
+inline constexpr int kMaxHighTagBits = 16;
+#else
+inline constexpr int kMaxHighTagBits = 0;
+#endif
+
+template <int kLowBits, int kHighBits>
+struct TagPacking {
+    static_assert(kLowBits >= 0 && kLowBits <= 3);
+    static_assert(kHighBits == 0 || kHighBits == kMaxHighTagBits,
+                  "High tag bits need x86-64 and take all 16 unused bits");
+    static_assert(sizeof(uintptr_t) == 8 || kHighBits == 0);
+
+    static constexpr uintptr_t kLowMask = (uintptr_t{1} << kLowBits) - 1;
+    static constexpr int kHighShift = 64 - kHighBits;
+    static constexpr uintptr_t kHighMask = ~(~uintptr_t{0} >> kHighBits);
+    static constexpr uintptr_t kMaxTag = (uintptr_t{1} << (kLowBits + kHighBits)) - 1;
+
+    static uintptr_t Address(uintptr_t word) {
+        return word & ~(kLowMask | kHighMask);
+    }
+
+    static uintptr_t Tag(uintptr_t word) {
+        uintptr_t tag = word & kLowMask;
+        if constexpr (kHighBits != 0) {
+            tag |= (word & kHighMask) >> (kHighShift - kLowBits);
+        }
+        return tag;
+    }
+
+    static uintptr_t Pack(uintptr_t address, uintptr_t tag) {
+        if (tag > kMaxTag) {
+            throw std::invalid_argument("Tag does not fit into the spare bits");
+        }
+        uintptr_t word = address | (tag & kLowMask);
+        if constexpr (kHighBits != 0) {
+            word |= (tag >> kLowBits) << kHighShift;
+        }
+        return word;
+    }
+};
+
+// Spare low bits of addresses aligned to `alignment`
+inline constexpr int TagLowBits(size_t alignment) {
+    return std::min(3, std::countr_zero(alignment));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// `SharedPtr` with the tag in the control block address: 16 bytes like `SharedPtr` itself
+
+template <typename T, typename Policy = DefaultSharedPolicy, int kHighBits = 0>
+class TaggedSharedPtr {
+    using Packing = TagPacking<TagLowBits(alignof(ControlBlockBase<Policy>)), kHighBits>;
+
+public:
+    using ElementType = std::remove_extent_t<T>;
+
+    static constexpr uintptr_t MaxTag() {
+        return Packing::kMaxTag;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    TaggedSharedPtr() {
+    }
+
+    TaggedSharedPtr(std::nullptr_t) {
+    }
+
+    // Takes over the reference of `ptr`, which is dropped if `tag` does not fit
+    TaggedSharedPtr(SharedPtr<T, Policy> ptr, uintptr_t tag = 0)
+        : word_(Packing::Pack(reinterpret_cast<uintptr_t>(ptr.block_), tag)), ptr_(ptr.ptr_) {
+        ptr.block_ = nullptr;
+        ptr.ptr_ = nullptr;
+    }
+
+    TaggedSharedPtr(const TaggedSharedPtr& other) : word_(other.word_), ptr_(other.ptr_) {
+        if (auto* block = GetBlock()) {
+            block->IncreaseStrong();
+        }
+    }
+
+    TaggedSharedPtr(TaggedSharedPtr&& other) noexcept : word_(other.word_), ptr_(other.ptr_) {
+        other.word_ = 0;
+        other.ptr_ = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    TaggedSharedPtr& operator=(const TaggedSharedPtr& other) {
+        if (this == &other) {
+            return *this;
+        }
+        if (auto* block = other.GetBlock()) {
+            block->IncreaseStrong();
+        }
+        if (auto* block = GetBlock()) {
+            block->DecreaseStrong();
+        }
+        word_ = other.word_;
+        ptr_ = other.ptr_;
+        return *this;
+    }
+
+    TaggedSharedPtr& operator=(TaggedSharedPtr&& other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+        if (auto* block = GetBlock()) {
+            block->DecreaseStrong();
+        }
+        word_ = other.word_;
+        ptr_ = other.ptr_;
+        other.word_ = 0;
+        other.ptr_ = nullptr;
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~TaggedSharedPtr() {
+        if (auto* block = GetBlock()) {
+            block->DecreaseStrong();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    // Drops both the pointer and the tag
+    void Reset() {
+        if (auto* block = GetBlock()) {
+            block->DecreaseStrong();
+        }
+        word_ = 0;
+        ptr_ = nullptr;
+    }
+
+    void SetTag(uintptr_t tag) {
+        word_ = Packing::Pack(Packing::Address(word_), tag);
+    }
+
+    void Swap(TaggedSharedPtr& other) noexcept {
+        std::swap(word_, other.word_);
+        std::swap(ptr_, other.ptr_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    uintptr_t GetTag() const {
+        return Packing::Tag(word_);
+    }
+
+    // A new owner of the same object, without the tag
+    SharedPtr<T, Policy> GetShared() const {
+        SharedPtr<T, Policy> result;
+        if (auto* block = GetBlock()) {
+            block->IncreaseStrong();
+            result.block_ = block;
+            result.ptr_ = ptr_;
+        }
+        return result;
+    }
+
+    ControlBlockBase<Policy>* GetBlock() const {
+        return reinterpret_cast<ControlBlockBase<Policy>*>(Packing::Address(word_));
+    }
+
+    ElementType* Get() const {
+        return ptr_;
+    }
+
+    ElementType& operator*() const {
+        return *ptr_;
+    }
+
+    ElementType* operator->() const {
+        return ptr_;
+    }
+
+    size_t UseCount() const {
+        if (auto* block = GetBlock()) {
+            return block->GetStrong();
+        }
+        return 0;
+    }
+
+    explicit operator bool() const {
+        return GetBlock();
+    }
+
+private:
+    uintptr_t word_ = 0;
+    ElementType* ptr_ = nullptr;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// `IntrusivePtr` with the tag in the object address: a single word. The low bits depend on
+// the alignment of `T`, which is only known once `T` is complete, so `MaxTag()` is a function.
+
+template <typename T, int kHighBits = 0>
+class TaggedIntrusivePtr {
+public:
+    static constexpr uintptr_t MaxTag() {
+        return Packing<>::kMaxTag;
+    }
+
+    // Constructors
+    TaggedIntrusivePtr() {
+    }
+
+    TaggedIntrusivePtr(std::nullptr_t) {
+    }
+
+    // Takes over the reference of `ptr`, which is dropped if `tag` does not fit
+    TaggedIntrusivePtr(IntrusivePtr<T> ptr, uintptr_t tag = 0)
+        : word_(Packing<>::Pack(reinterpret_cast<uintptr_t>(ptr.ptr_), tag)) {
+        ptr.ptr_ = nullptr;
+    }
+
+    TaggedIntrusivePtr(const TaggedIntrusivePtr& other) : word_(other.word_) {
+        if (T* ptr = Get()) {
+            ptr->IncRef();
+        }
+    }
+
+    TaggedIntrusivePtr(TaggedIntrusivePtr&& other) noexcept : word_(other.word_) {
+        other.word_ = 0;
+    }
+
+    // `operator=`-s
+    TaggedIntrusivePtr& operator=(const TaggedIntrusivePtr& other) {
+        if (this == &other) {
+            return *this;
+        }
+        if (T* ptr = other.Get()) {
+            ptr->IncRef();
+        }
+        if (T* ptr = Get()) {
+            ptr->DecRef();
+        }
+        word_ = other.word_;
+        return *this;
+    }
+
+    TaggedIntrusivePtr& operator=(TaggedIntrusivePtr&& other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+        if (T* ptr = Get()) {
+            ptr->DecRef();
+        }
+        word_ = std::exchange(other.word_, 0);
+        return *this;
+    }
+
+    // Destructor
+    ~TaggedIntrusivePtr() {
+        if (T* ptr = Get()) {
+            ptr->DecRef();
+        }
+    }
+
+    // Modifiers
+
+    // Drops both the pointer and the tag
+    void Reset() {
+        if (T* ptr = Get()) {
+            ptr->DecRef();
+        }
+        word_ = 0;
+    }
+
+    void SetTag(uintptr_t tag) {
+        word_ = Packing<>::Pack(Packing<>::Address(word_), tag);
+    }
+
+    void Swap(TaggedIntrusivePtr& other) noexcept {
+        std::swap(word_, other.word_);
+    }
+
+    // Observers
+    uintptr_t GetTag() const {
+        return Packing<>::Tag(word_);
+    }
+
+    // A new owner of the same object, without the tag
+    IntrusivePtr<T> GetIntrusive() const {
+        return IntrusivePtr<T>(Get());
+    }
+
+    T* Get() const {
+        return reinterpret_cast<T*>(Packing<>::Address(word_));
+    }
+
+    T& operator*() const {
+        return *Get();
+    }
+
+    T* operator->() const {
+        return Get();
+    }
+
+    size_t UseCount() const {
+        if (T* ptr = Get()) {
+            return ptr->RefCount();
+        }
+        return 0;
+    }
+
+    explicit operator bool() const {
+        return Get();
+    }
+
+private:
+    // A template, so that `alignof(T)` is taken once `T` is complete
+    template <typename U = T>
+    using Packing = TagPacking<TagLowBits(alignof(U)), kHighBits>;
+
+    uintptr_t word_ = 0;
+};
+
+template <typename T, typename Policy, int kHighBits>
+struct IsTriviallyRelocatable<TaggedSharedPtr<T, Policy, kHighBits>> : std::true_type {};
+
+template <typename T, int kHighBits>
+struct IsTriviallyRelocatable<TaggedIntrusivePtr<T, kHighBits>> : std::true_type {};
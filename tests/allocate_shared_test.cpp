@@ -0,0 +1,134 @@
+#include "check.h"
+#include "shared.h"
+#include "weak.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <stdexcept>
+
+// `AllocateShared` takes the block from the given allocator and gives it back through the
+// allocator rebound by the block, once the last weak reference is gone.
+
+namespace {
+
+// Bump allocation from a fixed buffer, with counts of the calls
+struct Arena {
+    bool Owns(const void* pointer) const {
+        auto* byte = static_cast<const std::byte*>(pointer);
+        return byte >= buffer && byte < buffer + sizeof(buffer);
+    }
+
+    alignas(std::max_align_t) std::byte buffer[4096];
+    size_t used = 0;
+    int allocations = 0;
+    int deallocations = 0;
+};
+
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena* arena) : arena(arena) {
+    }
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {
+    }
+
+    T* allocate(size_t size) {
+        size_t offset = (arena->used + alignof(T) - 1) / alignof(T) * alignof(T);
+        CHECK(offset + size * sizeof(T) <= sizeof(arena->buffer));
+        arena->used = offset + size * sizeof(T);
+        ++arena->allocations;
+        return reinterpret_cast<T*>(arena->buffer + offset);
+    }
+
+    void deallocate(T* pointer, size_t size) {
+        CHECK(arena->Owns(pointer) && size == 1);
+        ++arena->deallocations;
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return arena == other.arena;
+    }
+
+    Arena* arena;
+};
+
+int alive = 0;
+
+struct Tracked {
+    explicit Tracked(int value, bool fail = false) : value(value) {
+        if (fail) {
+            throw std::runtime_error("Tracked");
+        }
+        ++alive;
+    }
+
+    ~Tracked() {
+        --alive;
+    }
+
+    int value;
+};
+
+template <typename Policy>
+void TestFromArena() {
+    Arena arena;
+    {
+        auto ptr = AllocateShared<Tracked, Policy>(ArenaAllocator<char>(&arena), 42);
+        CHECK(ptr->value == 42 && alive == 1);
+        CHECK(arena.Owns(ptr.Get()) && arena.allocations == 1);
+        auto copy = ptr;
+        CHECK(copy.UseCount() == 2);
+    }
+    CHECK(alive == 0 && arena.deallocations == 1);
+}
+
+// The object goes with the last strong reference, the block with the last weak one
+template <typename Policy>
+void TestWeakOutlivesObject() {
+    Arena arena;
+    WeakPtr<Tracked, Policy> weak;
+    {
+        auto ptr = AllocateShared<Tracked, Policy>(ArenaAllocator<Tracked>(&arena), 1);
+        weak = ptr;
+    }
+    CHECK(alive == 0 && weak.Expired() && !weak.Lock());
+    CHECK(arena.deallocations == 0);
+    auto copy = weak;
+    weak.Reset();
+    CHECK(arena.deallocations == 0);
+    copy.Reset();
+    CHECK(arena.deallocations == 1);
+}
+
+template <typename Policy>
+void TestThrowingConstructor() {
+    Arena arena;
+    bool thrown = false;
+    try {
+        AllocateShared<Tracked, Policy>(ArenaAllocator<Tracked>(&arena), 1, true);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    CHECK(thrown && alive == 0);
+    CHECK(arena.allocations == 1 && arena.deallocations == 1);
+}
+
+template <typename Policy>
+void TestAll() {
+    TestFromArena<Policy>();
+    TestWeakOutlivesObject<Policy>();
+    TestThrowingConstructor<Policy>();
+}
+
+}  // namespace
+
+int main() {
+    TestAll<DefaultSharedPolicy>();
+    TestAll<PackedSharedPolicy>();
+    TestAll<SharedPolicy<SingleThreaded>>();
+    std::puts("allocate_shared_test: ok");
+}
@@ -0,0 +1,63 @@
+#include "check.h"
+#include "shared.h"
+#include "unique.h"
+
+#include <cstdio>
+#include <limits>
+#include <new>
+#include <stdexcept>
+
+// Array sizes whose byte count does not fit into `size_t` are rejected before allocation
+
+namespace {
+
+template <typename Function>
+bool ThrowsBadLength(Function function) {
+    try {
+        function();
+    } catch (const std::bad_array_new_length&) {
+        return true;
+    }
+    return false;
+}
+
+struct Wide {
+    char data[64];
+};
+
+// Hidden from the optimizer, which would warn about the sizes it could see
+volatile size_t max_size = std::numeric_limits<size_t>::max();
+
+void TestSharedArrayOverflow() {
+    CHECK(ThrowsBadLength([] { MakeShared<Wide[]>(max_size / sizeof(Wide) + 1); }));
+    CHECK(ThrowsBadLength([] { MakeShared<Wide[]>(max_size); }));
+    CHECK(ThrowsBadLength([] { MakeSharedForOverwrite<char[]>(max_size); }));
+    CHECK(MakeShared<Wide[]>(16).Get());
+}
+
+void TestAlignedArrayOverflow() {
+    CHECK(ThrowsBadLength([] { MakeUniqueAligned<Wide[]>(max_size / sizeof(Wide) + 1, 64); }));
+    CHECK(ThrowsBadLength([] { MakeUniqueAlignedForOverwrite<char[]>(max_size, 64); }));
+    // Fits into `size_t`, but not once rounded up to the alignment
+    CHECK(ThrowsBadLength([] { AllocateAligned(max_size - 8, 64, HugePages::kNo); }));
+    CHECK(MakeUniqueAligned<Wide[]>(16, 64).Get());
+}
+
+void TestAlignmentNotPowerOfTwo() {
+    bool thrown = false;
+    try {
+        MakeUniqueAligned<char[]>(16, 48);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+}  // namespace
+
+int main() {
+    TestSharedArrayOverflow();
+    TestAlignedArrayOverflow();
+    TestAlignmentNotPowerOfTwo();
+    std::puts("array_test: ok");
+}
@@ -0,0 +1,90 @@
+#include "atomic_shared.h"
+#include "check.h"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<int> constructed = 0;
+std::atomic<int> destroyed = 0;
+
+struct Snapshot {
+    explicit Snapshot(int value) : value(value) {
+        constructed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Snapshot() {
+        CHECK(alive);
+        alive = false;
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int value;
+    bool alive = true;
+};
+
+void TestSingleThreaded() {
+    {
+        AtomicSharedPtr<Snapshot> slot;
+        CHECK(!slot.Load());
+        slot.Store(MakeShared<Snapshot>(1));
+        CHECK(slot.Load()->value == 1);
+
+        auto previous = slot.Exchange(MakeShared<Snapshot>(2));
+        CHECK(previous->value == 1);
+        CHECK(previous.UseCount() == 1);
+
+        auto expected = previous;
+        CHECK(!slot.CompareExchange(expected, MakeShared<Snapshot>(3)));
+        CHECK(expected->value == 2);
+        CHECK(slot.CompareExchange(expected, MakeShared<Snapshot>(4)));
+        CHECK(slot.Load()->value == 4);
+    }
+    CHECK(constructed.load() == destroyed.load());
+}
+
+// Readers load and check snapshots while writers store and compare-exchange new ones
+void TestReadersAndWriters() {
+    constexpr int kReaders = 6;
+    constexpr int kWriters = 2;
+    constexpr int kOperations = 20000;
+    {
+        AtomicSharedPtr<Snapshot> slot(MakeShared<Snapshot>(0));
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kReaders; ++i) {
+            threads.emplace_back([&slot] {
+                for (int j = 0; j < kOperations; ++j) {
+                    auto snapshot = slot.Load();
+                    CHECK(snapshot && snapshot->alive && snapshot->value >= 0);
+                }
+            });
+        }
+        for (int i = 0; i < kWriters; ++i) {
+            threads.emplace_back([&slot, i] {
+                for (int j = 0; j < kOperations / 10; ++j) {
+                    if (j % 2 == 0) {
+                        slot.Store(MakeShared<Snapshot>(j));
+                        continue;
+                    }
+                    auto expected = slot.Load();
+                    slot.CompareExchange(expected, MakeShared<Snapshot>(j + i));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    CHECK(constructed.load() == destroyed.load());
+}
+
+}  // namespace
+
+int main() {
+    TestSingleThreaded();
+    TestReadersAndWriters();
+    std::puts("atomic_shared_test: ok");
+}
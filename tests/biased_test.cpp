@@ -0,0 +1,140 @@
+#include "biased.h"
+#include "check.h"
+#include "shared.h"
+#include "weak.h"
+
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Shared = SharedPtr<struct Tracked, BiasedSharedPolicy>;
+using Weak = WeakPtr<struct Tracked, BiasedSharedPolicy>;
+
+std::atomic<int> constructed = 0;
+std::atomic<int> destroyed = 0;
+
+struct Tracked {
+    Tracked() {
+        constructed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Tracked() {
+        CHECK(alive);
+        alive = false;
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool alive = true;
+};
+
+// The owner takes a reference, a foreign thread releases it, the owner drops its own one.
+// The count is zero while the object waits for the owner to drain it: no thread may lock it.
+void TestNoPromotionAfterCrossThreadRelease() {
+    auto object = MakeShared<Tracked, BiasedSharedPolicy>();
+    Weak weak(object);
+    Shared copy = object;
+    std::thread([copy = std::move(copy)]() mutable { copy.Reset(); }).join();
+    object.Reset();
+
+    CHECK(weak.UseCount() == 0);
+    CHECK(weak.Expired());
+    CHECK(!weak.Lock());
+    std::thread([&weak] {
+        CHECK(weak.Expired());
+        CHECK(!weak.Lock());
+    }).join();
+
+    BiasedOwner::DrainCurrent();
+    CHECK(constructed.load() == destroyed.load());
+}
+
+// Pointers used by a thread-local destructor that runs after the owner is closed
+struct LateUser {
+    ~LateUser() {
+        auto object = MakeShared<Tracked, BiasedSharedPolicy>();
+        Shared copy = object;
+        Weak weak(copy);
+        copy.Reset();
+        CHECK(weak.Lock());
+        object.Reset();
+        CHECK(!weak.Lock());
+    }
+};
+
+void TestLateThreadLocalDestructor() {
+    std::thread([] {
+        // Constructed before the owner, so destroyed after it
+        static thread_local LateUser late;
+        (void)&late;
+        auto object = MakeShared<Tracked, BiasedSharedPolicy>();
+    }).join();
+    CHECK(constructed.load() == destroyed.load());
+}
+
+// Foreign threads copy, drop and lock pointers to objects of the main thread
+void TestStress() {
+    constexpr int kThreads = 4;
+    constexpr int kRounds = 100;
+    constexpr int kOperations = 2000;
+    for (int round = 0; round < kRounds; ++round) {
+        auto object = MakeShared<Tracked, BiasedSharedPolicy>();
+        Weak weak(object);
+        std::vector<Shared> seeds(kThreads, object);
+        std::vector<std::thread> threads;
+        for (int index = 0; index < kThreads; ++index) {
+            threads.emplace_back([&weak, index, round, seed = std::move(seeds[index])]() mutable {
+                std::mt19937 random(round * kThreads + index);
+                std::vector<Shared> owned;
+                owned.push_back(std::move(seed));
+                for (int i = 0; i < kOperations; ++i) {
+                    switch (random() % 3) {
+                        case 0:
+                            if (!owned.empty()) {
+                                owned.push_back(owned.back());
+                            }
+                            break;
+                        case 1:
+                            if (!owned.empty()) {
+                                owned.pop_back();
+                            }
+                            break;
+                        default:
+                            if (auto locked = weak.Lock()) {
+                                CHECK(locked->alive);
+                                owned.push_back(std::move(locked));
+                            }
+                            break;
+                    }
+                }
+            });
+        }
+        // The owner keeps copying and dropping its own references meanwhile
+        for (int i = 0; i < kOperations; ++i) {
+            Shared copy = object;
+            if (auto locked = weak.Lock()) {
+                CHECK(locked->alive);
+            }
+        }
+        object.Reset();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        BiasedOwner::DrainCurrent();
+        CHECK(weak.Expired());
+        CHECK(!weak.Lock());
+        CHECK(constructed.load() == destroyed.load());
+    }
+}
+
+}  // namespace
+
+int main() {
+    TestNoPromotionAfterCrossThreadRelease();
+    TestLateThreadLocalDestructor();
+    TestStress();
+    std::puts("biased_test: ok");
+}
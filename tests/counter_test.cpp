@@ -0,0 +1,86 @@
+#include "check.h"
+#include "intrusive.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Thread-safe `RefCounted` counters keep exact counts under contention, and the padded one
+// keeps the payload off the counter's cache line
+
+namespace {
+
+static_assert(alignof(PaddedThreadSafeCounter) == kCacheLineSize);
+static_assert(sizeof(PaddedThreadSafeCounter) == kCacheLineSize);
+static_assert(sizeof(ThreadSafeCounter) == sizeof(size_t));
+
+int destroyed = 0;
+
+template <template <class, class> class Base>
+struct Node : Base<Node<Base>, DefaultDelete> {
+    ~Node() {
+        ++destroyed;
+    }
+
+    int value = 0;
+};
+
+template <class Derived, class D>
+using ThreadSafe = ThreadSafeRefCounted<Derived, D>;
+
+template <class Derived, class D>
+using Padded = PaddedThreadSafeRefCounted<Derived, D>;
+
+void TestPaddedLayout() {
+    static_assert(alignof(Node<Padded>) == kCacheLineSize);
+    static_assert(sizeof(Node<Padded>) == 2 * kCacheLineSize);
+    auto node = MakeIntrusive<Node<Padded>>();
+    auto address = reinterpret_cast<uintptr_t>(node.Get());
+    auto field = reinterpret_cast<uintptr_t>(&node->value);
+    CHECK(address % kCacheLineSize == 0);
+    CHECK(field - address >= kCacheLineSize);
+}
+
+template <template <class, class> class Base>
+void TestContention() {
+    constexpr int kThreads = 4;
+    constexpr int kOperations = 100000;
+    destroyed = 0;
+    {
+        auto node = MakeIntrusive<Node<Base>>();
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kThreads; ++i) {
+            threads.emplace_back([&node] {
+                for (int j = 0; j < kOperations; ++j) {
+                    IntrusivePtr<Node<Base>> copy = node;
+                    CHECK(copy->RefCount() >= 2);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        CHECK(node->RefCount() == 1 && destroyed == 0);
+    }
+    CHECK(destroyed == 1);
+}
+
+void TestTryIncRef() {
+    ThreadSafeCounter counter;
+    CHECK(!counter.TryIncRef() && counter.RefCount() == 0);
+    CHECK(counter.IncRef() == 1);
+    CHECK(counter.TryIncRef() && counter.RefCount() == 2);
+    CHECK(counter.DecRef() == 1 && counter.DecRef() == 0);
+    CHECK(!counter.TryIncRef());
+}
+
+}  // namespace
+
+int main() {
+    TestPaddedLayout();
+    TestContention<ThreadSafe>();
+    TestContention<Padded>();
+    TestTryIncRef();
+    std::puts("counter_test: ok");
+}
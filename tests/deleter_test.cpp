@@ -0,0 +1,158 @@
+#include "affine.h"
+#include "check.h"
+#include "deferred.h"
+#include "shared.h"
+#include "unique.h"
+#include "weak.h"
+
+#include <cstdio>
+#include <thread>
+#include <utility>
+
+// Deleters that hand objects elsewhere accept the null pointers `UniquePtr` passes them, and
+// `SharedPtr` calls its deleter exactly once, with the pointer it was given
+
+namespace {
+
+int destroyed = 0;
+
+struct Tracked {
+    ~Tracked() {
+        ++destroyed;
+    }
+};
+
+void TestDeferredDeleteNull() {
+    DeferredReclaimer& reclaimer = DeferredReclaimer::Global();
+    {
+        UniquePtr<Tracked, DeferredDelete> ptr;
+        ptr.Reset(new Tracked);
+        ptr = UniquePtr<Tracked, DeferredDelete>();
+        DeferredDelete()(static_cast<Tracked*>(nullptr));
+    }
+    CHECK(reclaimer.Pending() == 1);
+    CHECK(reclaimer.Drain() == 1 && destroyed == 1);
+}
+
+struct AffineNode : ThreadAffine {
+    ~AffineNode() {
+        ++destroyed;
+        destroyed_on = std::this_thread::get_id();
+    }
+
+    static inline std::thread::id destroyed_on;
+};
+
+void TestAffineDeleteNull() {
+    destroyed = 0;
+    {
+        UniquePtr<AffineNode, AffineDelete> ptr;
+        ptr.Reset(new AffineNode);
+        ptr = UniquePtr<AffineNode, AffineDelete>();
+    }
+    CHECK(destroyed == 1);
+}
+
+// Released by another thread, destroyed by the home thread at its next drain point
+void TestAffineReturnsHome() {
+    destroyed = 0;
+    UniquePtr<AffineNode, AffineDelete> ptr(new AffineNode);
+    std::thread([&ptr] { ptr.Reset(); }).join();
+    CHECK(destroyed == 0);
+    AffineHome::DrainCurrent();
+    CHECK(destroyed == 1 && AffineNode::destroyed_on == std::this_thread::get_id());
+}
+
+struct LateAffineUser {
+    ~LateAffineUser() {
+        // The home of this thread is gone, the object has none
+        UniquePtr<AffineNode, AffineDelete> ptr(new AffineNode);
+    }
+};
+
+void TestAffineAfterThreadExit() {
+    destroyed = 0;
+    std::thread([] {
+        static thread_local LateAffineUser late;
+        // Creates the home after `late`, so the home is closed first
+        UniquePtr<AffineNode, AffineDelete> ptr(new AffineNode);
+    }).join();
+    CHECK(destroyed == 2);
+}
+
+// Counts its calls and remembers the last pointer it was called with
+struct CountingDelete {
+    void operator()(Tracked* object) {
+        ++*calls;
+        *last = object;
+        delete object;
+    }
+
+    int* calls;
+    Tracked** last;
+};
+
+static_assert(sizeof(ControlBlockDeleter<Tracked, Slug<Tracked>>) ==
+              sizeof(ControlBlockPtr<Tracked>));
+
+void TestSharedDeleterOnce() {
+    destroyed = 0;
+    int calls = 0;
+    Tracked* last = nullptr;
+    auto* object = new Tracked;
+    WeakPtr<Tracked> weak;
+    {
+        SharedPtr<Tracked> ptr(object, CountingDelete{&calls, &last});
+        weak = ptr;
+        SharedPtr<Tracked> copy = ptr;
+        SharedPtr<Tracked> moved = std::move(copy);
+        ptr.Reset();
+        CHECK(calls == 0 && moved.UseCount() == 1);
+    }
+    CHECK(calls == 1 && last == object && destroyed == 1);
+
+    // The block outlives the object while weak references remain
+    CHECK(weak.Expired() && !weak.Lock());
+    weak.Reset();
+    CHECK(calls == 1);
+}
+
+void TestSharedResetDeleter() {
+    destroyed = 0;
+    int first_calls = 0;
+    int second_calls = 0;
+    Tracked* last = nullptr;
+    auto* first = new Tracked;
+    auto* second = new Tracked;
+    SharedPtr<Tracked> ptr(first, CountingDelete{&first_calls, &last});
+    ptr.Reset(second, CountingDelete{&second_calls, &last});
+    CHECK(first_calls == 1 && last == first && second_calls == 0 && ptr.Get() == second);
+    ptr.Reset();
+    CHECK(first_calls == 1 && second_calls == 1 && last == second && destroyed == 2);
+}
+
+void TestSharedFromUniqueDeleter() {
+    destroyed = 0;
+    int calls = 0;
+    Tracked* last = nullptr;
+    auto* object = new Tracked;
+    UniquePtr<Tracked, CountingDelete> unique(object, CountingDelete{&calls, &last});
+    {
+        SharedPtr<Tracked> shared(std::move(unique));
+        CHECK(!unique && shared.Get() == object);
+    }
+    CHECK(calls == 1 && last == object && destroyed == 1);
+}
+
+}  // namespace
+
+int main() {
+    TestDeferredDeleteNull();
+    TestAffineDeleteNull();
+    TestAffineReturnsHome();
+    TestAffineAfterThreadExit();
+    TestSharedDeleterOnce();
+    TestSharedResetDeleter();
+    TestSharedFromUniqueDeleter();
+    std::puts("deleter_test: ok");
+}
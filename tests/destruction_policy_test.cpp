@@ -0,0 +1,80 @@
+#include "check.h"
+#include "shared.h"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+// Destruction wrappers of a policy compose: deferred, then on the owner thread, then iterative
+
+namespace {
+
+std::atomic<int> destroyed = 0;
+std::thread::id destroyed_on;
+
+template <typename Policy>
+struct Node {
+    ~Node() {
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+        destroyed_on = std::this_thread::get_id();
+    }
+
+    SharedPtr<Node, Policy> next;
+};
+
+// Deep enough to overflow the stack when destroyed recursively
+constexpr int kChain = 1'000'000;
+
+template <typename Policy>
+SharedPtr<Node<Policy>, Policy> MakeChain(int length) {
+    SharedPtr<Node<Policy>, Policy> head;
+    for (int i = 0; i < length; ++i) {
+        auto node = MakeShared<Node<Policy>, Policy>();
+        node->next = std::move(head);
+        head = std::move(node);
+    }
+    return head;
+}
+
+// A chain released by a foreign thread goes home and is destroyed there iteratively
+void TestOwnerThreadThenIterative() {
+    using Policy = OwnerThreadDestruction<IterativeDestruction<DefaultSharedPolicy>>;
+    destroyed = 0;
+    auto head = MakeChain<Policy>(kChain);
+    std::thread([&head] { head.Reset(); }).join();
+    CHECK(destroyed == 0);
+    AffineHome::DrainCurrent();
+    CHECK(destroyed == kChain && destroyed_on == std::this_thread::get_id());
+}
+
+// The reclaimer hands the object to its owner thread instead of destroying it
+void TestDeferredThenOwnerThread() {
+    using Policy = DeferredDestruction<OwnerThreadDestruction<DefaultSharedPolicy>>;
+    destroyed = 0;
+    auto node = MakeShared<Node<Policy>, Policy>();
+    node.Reset();
+    CHECK(destroyed == 0 && DeferredReclaimer::Global().Pending() == 1);
+    std::thread([] { DeferredReclaimer::Global().Drain(); }).join();
+    CHECK(destroyed == 0);
+    AffineHome::DrainCurrent();
+    CHECK(destroyed == 1 && destroyed_on == std::this_thread::get_id());
+}
+
+void TestDeferredThenIterative() {
+    using Policy = DeferredDestruction<IterativeDestruction<DefaultSharedPolicy>>;
+    destroyed = 0;
+    auto head = MakeChain<Policy>(kChain);
+    head.Reset();
+    CHECK(destroyed == 0);
+    DeferredReclaimer::Global().Drain();
+    CHECK(destroyed == kChain && DeferredReclaimer::Global().Pending() == 0);
+}
+
+}  // namespace
+
+int main() {
+    TestOwnerThreadThenIterative();
+    TestDeferredThenOwnerThread();
+    TestDeferredThenIterative();
+    std::puts("destruction_policy_test: ok");
+}
@@ -0,0 +1,107 @@
+#include "check.h"
+#include "hazard.h"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<int> constructed = 0;
+std::atomic<int> destroyed = 0;
+
+struct Node : ThreadSafeRefCounted<Node> {
+    explicit Node(int value) : value(value) {
+        constructed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Node() {
+        CHECK(alive);
+        alive = false;
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int value;
+    bool alive = true;
+};
+
+// Retired objects of exited threads are adopted by the next scan
+void ReclaimAll() {
+    HazardDomain::Global().Flush();
+    CHECK(constructed.load() == destroyed.load());
+}
+
+// Readers protect or load the field while writers replace it
+void TestReadersAndWriters() {
+    constexpr int kReaders = 6;
+    constexpr int kWriters = 2;
+    constexpr int kOperations = 20000;
+    {
+        AtomicIntrusivePtr<Node> field(MakeIntrusive<Node>(0));
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kReaders; ++i) {
+            threads.emplace_back([&field, i] {
+                for (int j = 0; j < kOperations; ++j) {
+                    if ((i + j) % 2 == 0) {
+                        HazardGuard<Node> guard;
+                        Node* node = field.Protect(guard);
+                        CHECK(node && node->alive && node->RefCount() > 0);
+                    } else {
+                        auto node = field.Load();
+                        CHECK(node && node->alive);
+                    }
+                }
+            });
+        }
+        for (int i = 0; i < kWriters; ++i) {
+            threads.emplace_back([&field, i] {
+                for (int j = 0; j < kOperations / 10; ++j) {
+                    if (j % 2 == 0) {
+                        field.Store(MakeIntrusive<Node>(j));
+                    } else {
+                        auto previous = field.Exchange(MakeIntrusive<Node>(j + i));
+                        CHECK(previous && previous->alive);
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    ReclaimAll();
+}
+
+struct HazardNode : RefCounted<HazardNode, ThreadSafeCounter, HazardDelete> {
+    HazardNode() {
+        constructed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~HazardNode() {
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+// An object whose last reference is gone survives while a hazard covers it
+void TestHazardDelete() {
+    auto* node = new HazardNode();
+    IntrusivePtr<HazardNode> owner(node);
+    std::atomic<HazardNode*> source = node;
+    {
+        HazardGuard<HazardNode> guard;
+        CHECK(guard.Protect(source) == node);
+        owner.Reset();
+        HazardDomain::Global().Flush();
+        CHECK(destroyed.load() + 1 == constructed.load());
+    }
+    ReclaimAll();
+}
+
+}  // namespace
+
+int main() {
+    TestReadersAndWriters();
+    TestHazardDelete();
+    std::puts("hazard_test: ok");
+}
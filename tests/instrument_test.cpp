@@ -0,0 +1,127 @@
+#include "check.h"
+#include "intrusive.h"
+#include "shared.h"
+#include "unique.h"
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Allocations and frees of each pointer family match, and the families count separately
+
+namespace {
+
+struct Base {
+    virtual ~Base() = default;
+};
+
+struct Derived : Base {};
+
+struct Node : SimpleRefCounted<Node> {};
+
+struct Holder {
+    Node member;
+};
+
+InstrumentStats Find(std::string_view name) {
+    for (auto& stats : Instrumentation::Snapshot()) {
+        if (stats.type == name) {
+            return stats;
+        }
+    }
+    InstrumentStats empty;
+    empty.type = name;
+    return empty;
+}
+
+template <class T>
+std::string Name(std::string_view family = "") {
+    std::string name(TypeName<T>());
+    return family.empty() ? name : std::string(family) + '<' + name + '>';
+}
+
+uint64_t Allocations(const InstrumentStats& stats) {
+    return stats.Get(InstrumentEvent::kAllocation);
+}
+
+uint64_t Frees(const InstrumentStats& stats) {
+    return stats.Get(InstrumentEvent::kFree);
+}
+
+void TestUniqueAdoptsRawPointers() {
+    std::string name = Name<Derived>("UniquePtr");
+    {
+        UniquePtr<Derived> ptr(new Derived);
+        ptr = UniquePtr<Derived>(new Derived);
+        ptr.Reset(new Derived);
+        auto moved = std::move(ptr);
+    }
+    CHECK(Allocations(Find(name)) == 3 && Frees(Find(name)) == 3);
+
+    auto released = MakeUnique<Derived>().Release();
+    CHECK(Find(name).LiveObjects() == 0);
+    UniquePtr<Derived> adopted(released);
+    CHECK(Find(name).LiveObjects() == 1);
+
+    // Moving to a pointer to the base moves the object over to the base type
+    UniquePtr<Base> base(std::move(adopted));
+    CHECK(Find(name).LiveObjects() == 0 && Find(Name<Base>("UniquePtr")).LiveObjects() == 1);
+    base.Reset();
+    CHECK(Find(Name<Base>("UniquePtr")).LiveObjects() == 0);
+
+    auto array = MakeUnique<int[]>(4);
+    array = MakeUnique<int[]>(8);
+    array.Reset();
+    CHECK(Allocations(Find(Name<int[]>("UniquePtr"))) == 2);
+    CHECK(Find(Name<int[]>("UniquePtr")).LiveObjects() == 0);
+}
+
+void TestIntrusiveCountsReferencedObjects() {
+    std::string name = Name<Node>("IntrusivePtr");
+    {
+        Node on_stack;
+        Holder holder;
+        CHECK(Allocations(Find(name)) == 0);
+        auto node = MakeIntrusive<Node>();
+        auto copy = node;
+        CHECK(Allocations(Find(name)) == 1 && Find(name).LiveBytes() == sizeof(Node));
+    }
+    CHECK(Frees(Find(name)) == 1 && Find(name).LiveObjects() == 0 && Find(name).LiveBytes() == 0);
+}
+
+void TestFamiliesCountSeparately() {
+    auto shared = MakeShared<Derived>();
+    auto unique = MakeUnique<Derived>();
+    CHECK(Find(Name<Derived>()).LiveObjects() == 1);
+    CHECK(Find(Name<Derived>("UniquePtr")).LiveObjects() == 1);
+    shared.Reset();
+    CHECK(Find(Name<Derived>()).LiveObjects() == 0);
+    CHECK(Find(Name<Derived>("UniquePtr")).LiveObjects() == 1);
+}
+
+struct LateRelease {
+    SharedPtr<Derived> ptr;
+};
+
+// Released by a thread-local destructor after the thread has folded its counters
+void TestLateThreadLocalRelease() {
+    uint64_t frees = Frees(Find(Name<Derived>()));
+    std::thread([] {
+        // Constructed before the counters of the thread, so destroyed after them
+        static thread_local LateRelease late;
+        late.ptr = MakeShared<Derived>();
+    }).join();
+    CHECK(Frees(Find(Name<Derived>())) == frees + 1);
+    CHECK(Find(Name<Derived>()).LiveObjects() == 0);
+}
+
+}  // namespace
+
+int main() {
+    TestUniqueAdoptsRawPointers();
+    TestIntrusiveCountsReferencedObjects();
+    TestFamiliesCountSeparately();
+    TestLateThreadLocalRelease();
+    std::puts("instrument_test: ok");
+}
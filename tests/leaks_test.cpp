@@ -0,0 +1,92 @@
+#include "check.h"
+#include "shared.h"
+#include "weak.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Built with `SMART_PTR_TRACK_LEAKS`: blocks pinned by a cycle or by weak references show up
+// among the top sites with their counts, and disappear once released
+
+#ifndef SMART_PTR_TRACK_LEAKS
+#error "Build with SMART_PTR_TRACK_LEAKS"
+#endif
+
+namespace {
+
+struct CycleNode {
+    SharedPtr<CycleNode> next;
+};
+
+struct WeakOnlyNode {
+    int value = 0;
+};
+
+// Totals over the sites of blocks whose type name mentions `type`
+LeakSite Sum(const std::vector<LeakSite>& sites, const std::string& type) {
+    LeakSite total;
+    for (const auto& site : sites) {
+        if (site.type.find(type) != std::string::npos) {
+            total.blocks += site.blocks;
+            total.expired += site.expired;
+            total.strong += site.strong;
+            total.weak += site.weak;
+            total.frames.insert(total.frames.end(), site.frames.begin(), site.frames.end());
+        }
+    }
+    return total;
+}
+
+void TestCycle() {
+    CycleNode* first = nullptr;
+    {
+        auto a = MakeShared<CycleNode>();
+        auto b = MakeShared<CycleNode>();
+        a->next = b;
+        b->next = a;
+        first = a.Get();
+    }
+
+    LeakSite site = Sum(LeakTracker::TopSites(100), "CycleNode");
+    CHECK(site.blocks == 2 && site.strong == 2 && site.expired == 0);
+#ifdef SMART_PTR_HAS_BACKTRACE
+    CHECK(!site.frames.empty());
+#endif
+
+    // Breaking the cycle frees both blocks
+    first->next.Reset();
+    CHECK(Sum(LeakTracker::TopSites(100), "CycleNode").blocks == 0);
+}
+
+void TestWeakOnly() {
+    WeakPtr<WeakOnlyNode> weak;
+    {
+        auto object = MakeShared<WeakOnlyNode>();
+        weak = object;
+    }
+
+    LeakSite site = Sum(LeakTracker::TopSites(100), "WeakOnlyNode");
+    CHECK(site.blocks == 1 && site.expired == 1 && site.strong == 0 && site.weak == 1);
+
+    weak.Reset();
+    CHECK(Sum(LeakTracker::TopSites(100), "WeakOnlyNode").blocks == 0);
+}
+
+// Blocks younger than the minimum age are left out
+void TestMinAge() {
+    auto object = MakeShared<WeakOnlyNode>();
+    CHECK(Sum(LeakTracker::TopSites(100), "WeakOnlyNode").blocks == 1);
+    CHECK(Sum(LeakTracker::TopSites(100, std::chrono::hours(1)), "WeakOnlyNode").blocks == 0);
+}
+
+}  // namespace
+
+int main() {
+    LeakTracker::SetSampleRate(1);
+    TestCycle();
+    TestWeakOnly();
+    TestMinAge();
+    std::puts("leaks_test: ok");
+}
@@ -0,0 +1,88 @@
+#include "check.h"
+#include "shared.h"
+#include "weak.h"
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// `MakeSharedForOverwrite` builds the object in one allocation with its default constructor,
+// and destroys it once like any other shared object
+
+// Heap allocations, to see the object share the block's allocation
+long allocations = 0;
+
+void* operator new(size_t size) {
+    if (void* pointer = std::malloc(size ? size : 1)) {
+        ++allocations;
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+namespace {
+
+int constructed = 0;
+int destroyed = 0;
+
+struct Tracked {
+    Tracked() {
+        ++constructed;
+    }
+
+    ~Tracked() {
+        CHECK(alive);
+        alive = false;
+        ++destroyed;
+    }
+
+    int value = 7;
+    bool alive = true;
+};
+
+template <class Policy>
+void TestObject() {
+    // Instrumented builds allocate the statistics of a type on its first use
+    MakeSharedForOverwrite<Tracked, Policy>();
+    constructed = destroyed = 0;
+    long before = allocations;
+    WeakPtr<Tracked, Policy> weak;
+    {
+        auto ptr = MakeSharedForOverwrite<Tracked, Policy>();
+        CHECK(allocations == before + 1);
+        CHECK(constructed == 1 && ptr->value == 7 && ptr.UseCount() == 1);
+        weak = ptr;
+        auto copy = ptr;
+        CHECK(ptr.UseCount() == 2 && weak.Lock().Get() == ptr.Get());
+    }
+    CHECK(destroyed == 1 && weak.Expired() && !weak.Lock());
+}
+
+// Trivial payloads are left as they are, to be written by the caller
+void TestTrivial() {
+    MakeSharedForOverwrite<std::array<unsigned char, 4096>>();
+    long before = allocations;
+    auto buffer = MakeSharedForOverwrite<std::array<unsigned char, 4096>>();
+    CHECK(allocations == before + 1);
+    buffer->fill(0xAB);
+    SharedPtr<const std::array<unsigned char, 4096>> reader = buffer;
+    CHECK((*reader)[0] == 0xAB && (*reader)[4095] == 0xAB && buffer.UseCount() == 2);
+}
+
+}  // namespace
+
+int main() {
+    TestObject<DefaultSharedPolicy>();
+    TestObject<SharedPolicy<SingleThreaded, true>>();
+    TestTrivial();
+    std::puts("overwrite_test: ok");
+}
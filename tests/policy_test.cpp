@@ -0,0 +1,54 @@
+#include "check.h"
+#include "shared.h"
+
+#include <cstdio>
+
+// A strong-only policy drops the weak count from the block and frees it together with
+// the object
+
+namespace {
+
+using StrongOnly = SharedPolicy<MultiThreaded, false>;
+using SingleThreadedStrongOnly = SharedPolicy<SingleThreaded, false>;
+
+static_assert(sizeof(StrongCounter<MultiThreaded>) == sizeof(size_t));
+static_assert(sizeof(StrongWeakCounter<MultiThreaded>) == 2 * sizeof(size_t));
+static_assert(sizeof(ControlBlockPtr<int, StrongOnly>) + sizeof(size_t) ==
+              sizeof(ControlBlockPtr<int, DefaultSharedPolicy>));
+static_assert(sizeof(ControlBlockPtr<int, SingleThreadedStrongOnly>) ==
+              sizeof(ControlBlockPtr<int, StrongOnly>));
+static_assert(!StrongOnly::kWeak && DefaultSharedPolicy::kWeak);
+
+int alive = 0;
+
+struct Tracked {
+    Tracked() {
+        ++alive;
+    }
+
+    ~Tracked() {
+        --alive;
+    }
+};
+
+template <class Policy>
+void TestStrongOnly() {
+    {
+        auto ptr = MakeShared<Tracked, Policy>();
+        SharedPtr<Tracked, Policy> separate(new Tracked);
+        CHECK(alive == 2);
+        auto copy = ptr;
+        CHECK(ptr.UseCount() == 2 && copy.Get() == ptr.Get());
+        ptr.Reset();
+        CHECK(alive == 2 && copy.UseCount() == 1);
+    }
+    CHECK(alive == 0);
+}
+
+}  // namespace
+
+int main() {
+    TestStrongOnly<StrongOnly>();
+    TestStrongOnly<SingleThreadedStrongOnly>();
+    std::puts("policy_test: ok");
+}
@@ -0,0 +1,166 @@
+#include "check.h"
+#include "intrusive.h"
+#include "shared.h"
+#include "unique.h"
+#include "weak.h"
+
+#include <cstdio>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// `RelocateN` moves buffers of pointers by copying their bytes: no count changes, and every
+// object is still destroyed exactly once, by the relocated pointers
+
+static_assert(kTriviallyRelocatable<SharedPtr<int>>);
+static_assert(kTriviallyRelocatable<SharedPtr<int[]>>);
+static_assert(kTriviallyRelocatable<WeakPtr<int>>);
+static_assert(kTriviallyRelocatable<UniquePtr<int>>);
+static_assert(kTriviallyRelocatable<UniquePtr<int[]>>);
+
+static_assert(std::is_nothrow_move_constructible_v<SharedPtr<int>>);
+static_assert(std::is_nothrow_move_assignable_v<SharedPtr<int>>);
+static_assert(std::is_nothrow_move_constructible_v<WeakPtr<int>>);
+static_assert(std::is_nothrow_move_assignable_v<WeakPtr<int>>);
+static_assert(std::is_nothrow_move_constructible_v<UniquePtr<int>>);
+static_assert(std::is_nothrow_move_assignable_v<UniquePtr<int>>);
+
+namespace {
+
+int destroyed = 0;
+
+struct Tracked {
+    explicit Tracked(int value) : value(value) {
+    }
+
+    ~Tracked() {
+        CHECK(alive);
+        alive = false;
+        ++destroyed;
+    }
+
+    int value;
+    bool alive = true;
+};
+
+// Knows its own address, so it can only be moved by its move constructor
+struct SelfDeleter {
+    SelfDeleter() : self(this) {
+    }
+
+    SelfDeleter(SelfDeleter&&) noexcept : self(this) {
+    }
+
+    SelfDeleter& operator=(SelfDeleter&&) noexcept {
+        return *this;
+    }
+
+    void operator()(Tracked* object) {
+        CHECK(self == this);
+        delete object;
+    }
+
+    SelfDeleter* self;
+};
+
+static_assert(!kTriviallyRelocatable<UniquePtr<Tracked, SelfDeleter>>);
+
+struct Node : SimpleRefCounted<Node> {};
+
+static_assert(kTriviallyRelocatable<IntrusivePtr<Node>>);
+static_assert(std::is_nothrow_move_constructible_v<IntrusivePtr<Node>>);
+
+constexpr size_t kCount = 16;
+
+// Relocates `source` to fresh memory and releases the old buffer
+template <class T>
+T* Relocate(T* source) {
+    T* destination = std::allocator<T>().allocate(kCount);
+    CHECK(RelocateN(source, kCount, destination) == destination + kCount);
+    std::allocator<T>().deallocate(source, kCount);
+    return destination;
+}
+
+template <class T>
+void Release(T* buffer) {
+    std::destroy_n(buffer, kCount);
+    std::allocator<T>().deallocate(buffer, kCount);
+}
+
+void TestShared() {
+    destroyed = 0;
+    auto* buffer = std::allocator<SharedPtr<Tracked>>().allocate(kCount);
+    std::vector<Tracked*> objects;
+    for (size_t i = 0; i < kCount; ++i) {
+        new (buffer + i) SharedPtr<Tracked>(MakeShared<Tracked>(static_cast<int>(i)));
+        objects.push_back(buffer[i].Get());
+    }
+    SharedPtr<Tracked> witness = buffer[0];
+
+    buffer = Relocate(buffer);
+    for (size_t i = 0; i < kCount; ++i) {
+        CHECK(buffer[i].Get() == objects[i] && buffer[i]->value == static_cast<int>(i));
+        CHECK(buffer[i].UseCount() == (i == 0 ? 2 : 1));
+    }
+    CHECK(destroyed == 0);
+
+    Release(buffer);
+    CHECK(destroyed == static_cast<int>(kCount) - 1 && witness.UseCount() == 1);
+    witness.Reset();
+    CHECK(destroyed == static_cast<int>(kCount));
+}
+
+void TestWeak() {
+    destroyed = 0;
+    std::vector<SharedPtr<Tracked>> owners;
+    auto* buffer = std::allocator<WeakPtr<Tracked>>().allocate(kCount);
+    for (size_t i = 0; i < kCount; ++i) {
+        owners.push_back(MakeShared<Tracked>(static_cast<int>(i)));
+        new (buffer + i) WeakPtr<Tracked>(owners.back());
+    }
+
+    buffer = Relocate(buffer);
+    for (size_t i = 0; i < kCount; ++i) {
+        CHECK(buffer[i].UseCount() == 1 && buffer[i].Lock().Get() == owners[i].Get());
+    }
+
+    // The objects go with their owners, the blocks with the relocated weak pointers
+    owners.clear();
+    CHECK(destroyed == static_cast<int>(kCount));
+    for (size_t i = 0; i < kCount; ++i) {
+        CHECK(buffer[i].Expired() && !buffer[i].Lock());
+    }
+    Release(buffer);
+}
+
+template <class Deleter>
+void TestUnique() {
+    destroyed = 0;
+    auto* buffer = std::allocator<UniquePtr<Tracked, Deleter>>().allocate(kCount);
+    std::vector<Tracked*> objects;
+    for (size_t i = 0; i < kCount; ++i) {
+        objects.push_back(new Tracked(static_cast<int>(i)));
+        new (buffer + i) UniquePtr<Tracked, Deleter>(objects.back());
+    }
+
+    buffer = Relocate(buffer);
+    for (size_t i = 0; i < kCount; ++i) {
+        CHECK(buffer[i].Get() == objects[i]);
+    }
+    CHECK(destroyed == 0);
+
+    Release(buffer);
+    CHECK(destroyed == static_cast<int>(kCount));
+}
+
+}  // namespace
+
+int main() {
+    TestShared();
+    TestWeak();
+    TestUnique<Slug<Tracked>>();
+    // Not trivially relocatable: moved one by one
+    TestUnique<SelfDeleter>();
+    std::puts("relocate_test: ok");
+}
@@ -0,0 +1,98 @@
+#include "check.h"
+#include "slab.h"
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Slabs whose slots are all freed go back to the system, slabs with a live slot stay.
+// One free slab is kept as a spare until `Trim()`.
+
+namespace {
+
+using Pool = SlabPool<48>;
+
+std::vector<void*> AllocateMany(size_t count) {
+    std::vector<void*> slots;
+    for (size_t i = 0; i < count; ++i) {
+        slots.push_back(Pool::Allocate());
+    }
+    return slots;
+}
+
+void TestTrim() {
+    auto slots = AllocateMany(20000);
+    size_t peak = Pool::SlabCount();
+    CHECK(peak >= 20000 * 48 / (64 * 1024));
+
+    // One slot keeps its slab
+    void* kept = slots.back();
+    slots.pop_back();
+    for (void* slot : slots) {
+        Pool::Deallocate(slot);
+    }
+    Pool::TrimCurrentThread();
+    Pool::Trim();
+    CHECK(Pool::SlabCount() == 1);
+
+    // The slots left on the global list are still usable
+    slots = AllocateMany(100);
+    for (void* slot : slots) {
+        Pool::Deallocate(slot);
+    }
+    Pool::Deallocate(kept);
+    Pool::TrimCurrentThread();
+    Pool::Trim();
+    CHECK(Pool::SlabCount() == 0);
+}
+
+// A slab goes back to the system once all of its slots are freed, without explicit calls
+void TestReleaseOnFree() {
+    std::vector<void*> slots;
+    std::thread([&] { slots = AllocateMany(50000); }).join();
+    size_t peak = Pool::SlabCount();
+    std::thread([&] {
+        for (void* slot : slots) {
+            Pool::Deallocate(slot);
+        }
+    }).join();
+    // Only the spare is left
+    CHECK(Pool::SlabCount() <= 1 && peak > 1);
+    Pool::Trim();
+    CHECK(Pool::SlabCount() == 0);
+}
+
+// Every slab keeps one slot: nothing is released, and freeing stays cheap
+void TestFragmented() {
+    // Fresh slabs are handed out in address order and hold more than 1000 slots
+    constexpr size_t kStride = 1000;
+    auto slots = AllocateMany(200000);
+    size_t peak = Pool::SlabCount();
+    std::vector<void*> kept;
+    for (size_t i = 0; i < slots.size(); ++i) {
+        if (i % kStride == 0 || i + 1 == slots.size()) {
+            kept.push_back(slots[i]);
+        } else {
+            Pool::Deallocate(slots[i]);
+        }
+    }
+    Pool::TrimCurrentThread();
+    Pool::Trim();
+    CHECK(Pool::SlabCount() == peak);
+
+    for (void* slot : kept) {
+        Pool::Deallocate(slot);
+    }
+    Pool::TrimCurrentThread();
+    Pool::Trim();
+    CHECK(Pool::SlabCount() == 0);
+}
+
+}  // namespace
+
+int main() {
+    TestTrim();
+    TestReleaseOnFree();
+    TestFragmented();
+    std::puts("slab_test: ok");
+}
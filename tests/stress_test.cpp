@@ -0,0 +1,92 @@
+#include "check.h"
+#include "shared.h"
+#include "weak.h"
+
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Many threads copy, drop and lock pointers to one object until the last owner is gone.
+// The object must be destroyed exactly once and never handed out after that.
+
+namespace {
+
+std::atomic<int> constructed = 0;
+std::atomic<int> destroyed = 0;
+
+struct Tracked {
+    Tracked() {
+        constructed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Tracked() {
+        CHECK(alive);
+        alive = false;
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool alive = true;
+};
+
+constexpr int kThreads = 8;
+constexpr int kRounds = 100;
+constexpr int kOperations = 2000;
+
+template <typename Policy>
+void Stress() {
+    for (int round = 0; round < kRounds; ++round) {
+        auto object = MakeShared<Tracked, Policy>();
+        WeakPtr<Tracked, Policy> weak(object);
+        std::vector<SharedPtr<Tracked, Policy>> seeds(kThreads, object);
+        object.Reset();
+
+        std::vector<std::thread> threads;
+        for (int index = 0; index < kThreads; ++index) {
+            threads.emplace_back([&weak, index, round, seed = std::move(seeds[index])]() mutable {
+                std::mt19937 random(round * kThreads + index);
+                std::vector<SharedPtr<Tracked, Policy>> owned;
+                owned.push_back(std::move(seed));
+                WeakPtr<Tracked, Policy> local_weak = weak;
+                for (int i = 0; i < kOperations; ++i) {
+                    switch (random() % 4) {
+                        case 0:
+                            if (!owned.empty()) {
+                                owned.push_back(owned.back());
+                            }
+                            break;
+                        case 1:
+                            if (!owned.empty()) {
+                                owned.pop_back();
+                            }
+                            break;
+                        case 2:
+                            if (auto locked = local_weak.Lock()) {
+                                CHECK(locked->alive);
+                                owned.push_back(std::move(locked));
+                            }
+                            break;
+                        default:
+                            local_weak = WeakPtr<Tracked, Policy>(weak);
+                            break;
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        CHECK(weak.Expired());
+        CHECK(!weak.Lock());
+        CHECK(constructed.load() == destroyed.load());
+    }
+}
+
+}  // namespace
+
+int main() {
+    Stress<DefaultSharedPolicy>();
+    Stress<PackedSharedPolicy>();
+    std::puts("stress_test: ok");
+}
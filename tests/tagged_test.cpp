@@ -0,0 +1,146 @@
+#include "check.h"
+#include "tagged.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include <utility>
+
+// Tags survive copies and moves, never show up in the pointer, and a tag that does not fit
+// is rejected
+
+namespace {
+
+struct Node : SimpleRefCounted<Node> {
+    explicit Node(int value) : value(value) {
+    }
+
+    int value;
+};
+
+template <class Ptr>
+void CheckTagged(const Ptr& ptr, const void* object, uintptr_t tag) {
+    CHECK(ptr.Get() == object && ptr.GetTag() == tag);
+}
+
+// Every tag from the low bits, and a spread of tags reaching into the high bits
+template <class Ptr>
+void TestRoundTrip(Ptr ptr) {
+    const void* object = ptr.Get();
+    uintptr_t max_tag = Ptr::MaxTag();
+    for (uintptr_t tag = 0; tag <= max_tag; tag = tag < 16 ? tag + 1 : tag * 3 + 1) {
+        ptr.SetTag(tag);
+        CheckTagged(ptr, object, tag);
+        CHECK(ptr->value == 42);
+    }
+    ptr.SetTag(max_tag);
+    CheckTagged(ptr, object, max_tag);
+    CHECK((*ptr).value == 42);
+}
+
+template <class Ptr>
+void TestCopyAndMove(Ptr ptr) {
+    const void* object = ptr.Get();
+    uintptr_t tag = Ptr::MaxTag() / 2 + 1;
+    size_t count = ptr.UseCount();
+    ptr.SetTag(tag);
+
+    Ptr copy = ptr;
+    CheckTagged(copy, object, tag);
+    CHECK(ptr.UseCount() == count + 1);
+
+    Ptr moved = std::move(copy);
+    CheckTagged(moved, object, tag);
+    CHECK(!copy && copy.GetTag() == 0 && ptr.UseCount() == count + 1);
+
+    Ptr assigned;
+    assigned = moved;
+    CheckTagged(assigned, object, tag);
+    assigned.SetTag(1);
+    CHECK(moved.GetTag() == tag && ptr.UseCount() == count + 2);
+
+    Ptr move_assigned;
+    move_assigned = std::move(assigned);
+    CheckTagged(move_assigned, object, 1);
+    CHECK(!assigned && ptr.UseCount() == count + 2);
+
+    move_assigned.Swap(moved);
+    CheckTagged(move_assigned, object, tag);
+    CheckTagged(moved, object, 1);
+
+    moved.Reset();
+    CHECK(!moved && moved.GetTag() == 0 && ptr.UseCount() == count + 1);
+}
+
+template <class Ptr>
+void TestOversizedTag(Ptr ptr) {
+    uintptr_t tag = ptr.GetTag();
+    bool thrown = false;
+    try {
+        ptr.SetTag(Ptr::MaxTag() + 1);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown && ptr.GetTag() == tag && ptr->value == 42);
+}
+
+template <int kHighBits>
+void TestShared() {
+    using Ptr = TaggedSharedPtr<Node, DefaultSharedPolicy, kHighBits>;
+    static_assert(sizeof(Ptr) == sizeof(SharedPtr<Node>));
+    auto shared = MakeShared<Node>(42);
+    TestRoundTrip(Ptr(shared, 1));
+    TestCopyAndMove(Ptr(shared));
+    TestOversizedTag(Ptr(shared, Ptr::MaxTag()));
+
+    // The untagged pointer goes out
+    Ptr tagged(shared, Ptr::MaxTag());
+    SharedPtr<Node> untagged = tagged.GetShared();
+    CHECK(untagged.Get() == shared.Get() && shared.UseCount() == 3);
+
+    // The reference handed to a constructor that throws is dropped
+    bool thrown = false;
+    try {
+        Ptr(shared, Ptr::MaxTag() + 1);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown && shared.UseCount() == 3);
+}
+
+template <int kHighBits>
+void TestIntrusive() {
+    using Ptr = TaggedIntrusivePtr<Node, kHighBits>;
+    static_assert(sizeof(Ptr) == sizeof(void*));
+    auto intrusive = MakeIntrusive<Node>(42);
+    TestRoundTrip(Ptr(intrusive, 1));
+    TestCopyAndMove(Ptr(intrusive));
+    TestOversizedTag(Ptr(intrusive, Ptr::MaxTag()));
+
+    Ptr tagged(intrusive, Ptr::MaxTag());
+    IntrusivePtr<Node> untagged = tagged.GetIntrusive();
+    CHECK(untagged.Get() == intrusive.Get() && intrusive.UseCount() == 3);
+
+    bool thrown = false;
+    try {
+        Ptr(intrusive, Ptr::MaxTag() + 1);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown && intrusive.UseCount() == 3);
+}
+
+}  // namespace
+
+int main() {
+    static_assert(TaggedSharedPtr<Node>::MaxTag() == 7);
+    static_assert(TaggedIntrusivePtr<Node>::MaxTag() == 7);
+    TestShared<0>();
+    TestIntrusive<0>();
+    if constexpr (kMaxHighTagBits != 0) {
+        static_assert(TaggedSharedPtr<Node, DefaultSharedPolicy, kMaxHighTagBits>::MaxTag() ==
+                      (uintptr_t{1} << 19) - 1);
+        TestShared<kMaxHighTagBits>();
+        TestIntrusive<kMaxHighTagBits>();
+    }
+    std::puts("tagged_test: ok");
+}
@@ -0,0 +1,147 @@
+#include "check.h"
+#include "intrusive_weak.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+// Weak references to `RefCounted` objects never hand out a destroyed object, and the side
+// table goes with the last of the object and its weak references
+
+// Live heap allocations, to see the side table freed
+std::atomic<long> live_allocations = 0;
+
+void* operator new(size_t size) {
+    if (void* pointer = std::malloc(size ? size : 1)) {
+        live_allocations.fetch_add(1, std::memory_order_relaxed);
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    if (pointer) {
+        live_allocations.fetch_sub(1, std::memory_order_relaxed);
+        std::free(pointer);
+    }
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+namespace {
+
+std::atomic<int> constructed = 0;
+std::atomic<int> destroyed = 0;
+
+template <class Base>
+struct Node : Base {
+    Node() {
+        constructed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Node() {
+        CHECK(alive);
+        alive = false;
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool alive = true;
+};
+
+struct SimpleNode : Node<SimpleWeakRefCounted<SimpleNode>> {};
+struct SharedNode : Node<ThreadSafeWeakRefCounted<SharedNode>> {};
+
+template <class T>
+void TestLockAfterRelease() {
+    auto object = MakeIntrusive<T>();
+    WeakIntrusivePtr<T> weak(object);
+    {
+        auto locked = weak.Lock();
+        CHECK(locked.Get() == object.Get() && weak.UseCount() == 2);
+    }
+    CHECK(weak.UseCount() == 1 && !weak.Expired());
+
+    object.Reset();
+    CHECK(constructed.load() == destroyed.load());
+    CHECK(weak.Expired() && weak.UseCount() == 0);
+    CHECK(!weak.Lock());
+}
+
+template <class T>
+void TestTableFreed() {
+    long before = live_allocations.load();
+    {
+        // Weak references outlive the object
+        auto object = MakeIntrusive<T>();
+        WeakIntrusivePtr<T> weak(object);
+        WeakIntrusivePtr<T> copy = weak;
+        CHECK(live_allocations.load() == before + 2);
+        object.Reset();
+        CHECK(live_allocations.load() == before + 1);
+        weak.Reset();
+        CHECK(live_allocations.load() == before + 1);
+        copy.Reset();
+        CHECK(live_allocations.load() == before);
+    }
+    {
+        // The object outlives its weak references
+        auto object = MakeIntrusive<T>();
+        WeakIntrusivePtr<T> weak(object);
+        weak.Reset();
+        CHECK(live_allocations.load() == before + 2);
+        object.Reset();
+        CHECK(live_allocations.load() == before);
+    }
+    {
+        // Never weakly referenced objects get no table
+        auto object = MakeIntrusive<T>();
+        CHECK(live_allocations.load() == before + 1);
+    }
+    CHECK(live_allocations.load() == before);
+}
+
+// Threads lock while the last strong reference goes away
+void TestLockRacesRelease() {
+    constexpr int kThreads = 4;
+    constexpr int kRounds = 200;
+    for (int round = 0; round < kRounds; ++round) {
+        auto object = MakeIntrusive<SharedNode>();
+        WeakIntrusivePtr<SharedNode> weak(object);
+        std::atomic<int> ready = 0;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kThreads; ++i) {
+            threads.emplace_back([&weak, &ready] {
+                WeakIntrusivePtr<SharedNode> local = weak;
+                ready.fetch_add(1, std::memory_order_relaxed);
+                while (auto locked = local.Lock()) {
+                    CHECK(locked->alive);
+                }
+            });
+        }
+        while (ready.load(std::memory_order_relaxed) != kThreads) {
+            std::this_thread::yield();
+        }
+        object.Reset();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        CHECK(weak.Expired() && !weak.Lock());
+        CHECK(constructed.load() == destroyed.load());
+    }
+}
+
+}  // namespace
+
+int main() {
+    TestLockAfterRelease<SimpleNode>();
+    TestLockAfterRelease<SharedNode>();
+    TestTableFreed<SimpleNode>();
+    TestTableFreed<SharedNode>();
+    TestLockRacesRelease();
+    std::puts("weak_intrusive_test: ok");
+}
@@ -1,8 +1,20 @@
 #pragma once
 
 #include "compressed_pair.h"
+#include "instrument.h"
+#include "relocate.h"
 
+#include <bit>
 #include <cstddef>  // std::nullptr_t
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 
 template <class T>
 struct Slug {
@@ -60,15 +72,23 @@ public:
     // Constructors
 
     explicit UniquePtr(T* ptr = nullptr) : pair_(ptr, Deleter()) {
+        SMART_PTR_COUNT(TypeId(), kAllocation, ptr != nullptr);
     }
 
     UniquePtr(T* ptr, Deleter deleter) : pair_(ptr, std::move(deleter)) {
+        SMART_PTR_COUNT(TypeId(), kAllocation, ptr != nullptr);
+    }
+
+    UniquePtr(UniquePtr&& other) noexcept
+        : pair_(std::exchange(other.pair_.GetFirst(), nullptr), std::move(other.GetDeleter())) {
     }
 
+    // The object moves over to the accounting of this type
     template <class X, class Y = Slug<X>>
     UniquePtr(UniquePtr<X, Y>&& other) noexcept {
         pair_.GetFirst() = other.Release();
         pair_.GetSecond() = std::move(other.GetDeleter());
+        SMART_PTR_COUNT(TypeId(), kAllocation, pair_.GetFirst() != nullptr);
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -79,6 +99,7 @@ public:
             return *this;
         }
 
+        SMART_PTR_COUNT(TypeId(), kFree, pair_.GetFirst() != nullptr);
         GetDeleter()(pair_.GetFirst());
 
         pair_.GetFirst() = other.pair_.GetFirst();
@@ -108,16 +129,19 @@ public:
     T* Release() {
         auto temp = pair_.GetFirst();
         pair_.GetFirst() = nullptr;
+        SMART_PTR_COUNT(TypeId(), kFree, temp != nullptr);
         return temp;
     }
 
     void Reset(T* ptr = nullptr) {
         auto temp = pair_.GetFirst();
         pair_.GetFirst() = ptr;
+        SMART_PTR_COUNT(TypeId(), kAllocation, ptr != nullptr);
+        SMART_PTR_COUNT(TypeId(), kFree, temp != nullptr);
         GetDeleter()(temp);
     }
 
-    void Swap(UniquePtr& other) {
+    void Swap(UniquePtr& other) noexcept {
         std::swap(pair_, other.pair_);
     }
 
@@ -153,8 +177,13 @@ public:
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Help Functions
+    static uint32_t TypeId() {
+        return Instrumentation::TypeId<T, UniqueFamily>();
+    }
+
     void DeletePtr() {
         if (pair_.GetFirst()) {
+            SMART_PTR_COUNT(TypeId(), kFree, 1);
             GetDeleter()(pair_.GetFirst());
             pair_.GetFirst() = nullptr;
         }
@@ -174,22 +203,32 @@ public:
     // Constructors
 
     explicit UniquePtr(T* ptr = nullptr) : pair_(ptr, Deleter()) {
+        SMART_PTR_COUNT(TypeId(), kAllocation, ptr != nullptr);
     }
 
     UniquePtr(T* ptr, Deleter deleter) : pair_(ptr, std::move(deleter)) {
+        SMART_PTR_COUNT(TypeId(), kAllocation, ptr != nullptr);
     }
 
+    UniquePtr(UniquePtr&& other) noexcept
+        : pair_(std::exchange(other.pair_.GetFirst(), nullptr), std::move(other.GetDeleter())) {
+    }
+
+    // The object moves over to the accounting of this type
     template <class X, class Y = Slug<X>>
     UniquePtr(UniquePtr<X, Y>&& other) noexcept {
         pair_.GetFirst() = other.Release();
         pair_.GetSecond() = std::move(other.GetDeleter());
+        SMART_PTR_COUNT(TypeId(), kAllocation, pair_.GetFirst() != nullptr);
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // `operator=`-s
 
     UniquePtr& operator=(UniquePtr&& other) noexcept {
-        Reset(other.Release());
+        T* ptr = std::exchange(other.pair_.GetFirst(), nullptr);
+        DeletePtr();
+        pair_.GetFirst() = ptr;
         pair_.GetSecond() =
             std::forward<Deleter>(other.GetDeleter());  // std::move(other.GetDeleter()) ??
         return *this;
@@ -214,16 +253,19 @@ public:
     T* Release() {
         auto temp = pair_.GetFirst();
         pair_.GetFirst() = nullptr;
+        SMART_PTR_COUNT(TypeId(), kFree, temp != nullptr);
         return temp;
     }
 
     void Reset(T* ptr = nullptr) {
         auto temp = pair_.GetFirst();
         pair_.GetFirst() = ptr;
+        SMART_PTR_COUNT(TypeId(), kAllocation, ptr != nullptr);
+        SMART_PTR_COUNT(TypeId(), kFree, temp != nullptr);
         GetDeleter()(temp);
     }
 
-    void Swap(UniquePtr& other) {
+    void Swap(UniquePtr& other) noexcept {
         std::swap(pair_, other.pair_);
     }
 
@@ -263,8 +305,13 @@ public:
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Help Functions
+    static uint32_t TypeId() {
+        return Instrumentation::TypeId<T[], UniqueFamily>();
+    }
+
     void DeletePtr() {
         if (pair_.GetFirst()) {
+            SMART_PTR_COUNT(TypeId(), kFree, 1);
             GetDeleter()(pair_.GetFirst());
             pair_.GetFirst() = nullptr;
         }
@@ -275,3 +322,114 @@ public:
 
     CompressedPair<T*, Deleter> pair_;
 };
+
+// Relocatable as long as the deleter is
+template <typename T, typename Deleter>
+struct IsTriviallyRelocatable<UniquePtr<T, Deleter>> : IsTriviallyRelocatable<Deleter> {};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Factories. `UniquePtr` accounts objects, not bytes: an object counts as allocated when a
+// `UniquePtr` takes it over and as freed when one deletes or releases it.
+
+template <typename T, typename... Args>
+    requires(!std::is_array_v<T>)
+UniquePtr<T> MakeUnique(Args&&... args) {
+    return UniquePtr<T>(new T(std::forward<Args>(args)...));
+}
+
+template <typename T>
+    requires std::is_unbounded_array_v<T>
+UniquePtr<T> MakeUnique(size_t size) {
+    return UniquePtr<T>(new std::remove_extent_t<T>[size]());
+}
+
+// Default-initialized: trivial types are left uninitialized
+template <typename T>
+    requires(!std::is_array_v<T>)
+UniquePtr<T> MakeUniqueForOverwrite() {
+    return UniquePtr<T>(new T);
+}
+
+template <typename T>
+    requires std::is_unbounded_array_v<T>
+UniquePtr<T> MakeUniqueForOverwrite(size_t size) {
+    return UniquePtr<T>(new std::remove_extent_t<T>[size]);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Over-aligned buffers of trivial types, e.g. for vectorized kernels
+
+// Releases memory of `MakeUniqueAligned`, stateless so it takes no space in `UniquePtr`
+struct AlignedDeleter {
+    template <class T>
+    void operator()(T* ptr) const {
+        std::free(ptr);
+    }
+};
+
+enum class HugePages {
+    kNo,
+    // Align large buffers to 2 MiB and ask the kernel to back them with transparent huge pages
+    kAdvise,
+};
+
+inline constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+inline void* AllocateAligned(size_t bytes, size_t alignment, HugePages huge_pages) {
+    if (!std::has_single_bit(alignment)) {
+        throw std::invalid_argument("Alignment must be a power of two");
+    }
+    bool huge = huge_pages == HugePages::kAdvise && bytes >= kHugePageSize;
+    if (huge && alignment < kHugePageSize) {
+        alignment = kHugePageSize;
+    }
+    if (alignment < sizeof(void*)) {
+        alignment = sizeof(void*);
+    }
+    // `aligned_alloc` wants a multiple of the alignment
+    if (bytes > std::numeric_limits<size_t>::max() - (alignment - 1)) {
+        throw std::bad_array_new_length();
+    }
+    bytes = (bytes + alignment - 1) / alignment * alignment;
+    void* memory = std::aligned_alloc(alignment, bytes == 0 ? alignment : bytes);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+#ifdef MADV_HUGEPAGE
+    if (huge) {
+        madvise(memory, bytes, MADV_HUGEPAGE);
+    }
+#endif
+    return memory;
+}
+
+// Bytes taken by `size` elements of `E`
+template <typename E>
+size_t AlignedArrayBytes(size_t size) {
+    if (size > std::numeric_limits<size_t>::max() / sizeof(E)) {
+        throw std::bad_array_new_length();
+    }
+    return size * sizeof(E);
+}
+
+// Value-initialized array of `size` elements aligned to `alignment` (a power of two)
+template <typename T>
+    requires std::is_unbounded_array_v<T>
+UniquePtr<T, AlignedDeleter> MakeUniqueAligned(size_t size, size_t alignment,
+                                               HugePages huge_pages = HugePages::kNo) {
+    using E = std::remove_extent_t<T>;
+    static_assert(std::is_trivially_destructible_v<E>, "AlignedDeleter does not run destructors");
+    void* memory = AllocateAligned(AlignedArrayBytes<E>(size), alignment, huge_pages);
+    return UniquePtr<T, AlignedDeleter>(new (memory) E[size]());
+}
+
+// Same as `MakeUniqueAligned`, but elements are left uninitialized
+template <typename T>
+    requires std::is_unbounded_array_v<T>
+UniquePtr<T, AlignedDeleter> MakeUniqueAlignedForOverwrite(size_t size, size_t alignment,
+                                                           HugePages huge_pages = HugePages::kNo) {
+    using E = std::remove_extent_t<T>;
+    static_assert(std::is_trivially_destructible_v<E>, "AlignedDeleter does not run destructors");
+    void* memory = AllocateAligned(AlignedArrayBytes<E>(size), alignment, huge_pages);
+    return UniquePtr<T, AlignedDeleter>(new (memory) E[size]);
+}
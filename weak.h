@@ -4,9 +4,11 @@
 #include <utility>
 
 // https://en.cppreference.com/w/cpp/memory/weak_ptr
-template <typename T>
+template <typename T, typename Policy>
 class WeakPtr {
 public:
+    using ElementType = std::remove_extent_t<T>;
+
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Constructors
 
@@ -21,7 +23,7 @@ public:
         ptr_ = other.ptr_;
     }
 
-    WeakPtr(WeakPtr&& other) {
+    WeakPtr(WeakPtr&& other) noexcept {
         block_ = other.block_;
         ptr_ = other.ptr_;
         other.block_ = nullptr;
@@ -30,7 +32,7 @@ public:
 
     // Demote `SharedPtr`
     // #2 from https://en.cppreference.com/w/cpp/memory/weak_ptr/weak_ptr
-    WeakPtr(const SharedPtr<T>& other) {
+    WeakPtr(const SharedPtr<T, Policy>& other) {
         block_ = other.block_;
         if (block_) {
             block_->IncreaseWeak();
@@ -38,7 +40,7 @@ public:
         ptr_ = other.ptr_;
     }
 
-    WeakPtr(T* ptr, ControlBlockBase* block) : ptr_(ptr), block_(block) {
+    WeakPtr(ElementType* ptr, ControlBlockBase<Policy>* block) : ptr_(ptr), block_(block) {
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -59,7 +61,7 @@ public:
         return *this;
     }
 
-    WeakPtr& operator=(WeakPtr&& other) {
+    WeakPtr& operator=(WeakPtr&& other) noexcept {
         if (this == &other) {
             return *this;
         }
@@ -77,6 +79,7 @@ public:
     // Destructor
 
     ~WeakPtr() {
+        static_assert(Policy::kWeak, "SharedPtr policy does not support weak references");
         if (block_) {
             block_->DecreaseWeak();
         }
@@ -93,7 +96,7 @@ public:
         ptr_ = nullptr;
     }
 
-    void Swap(WeakPtr& other) {
+    void Swap(WeakPtr& other) noexcept {
         std::swap(block_, other.block_);
         std::swap(ptr_, other.ptr_);
     }
@@ -115,10 +118,15 @@ public:
         return block_->GetStrong() == 0;
     }
 
-    SharedPtr<T> Lock() const {
-        return Expired() ? SharedPtr<T>() : SharedPtr<T>(*this);
+    SharedPtr<T, Policy> Lock() const {
+        SharedPtr<T, Policy> result;
+        if (block_ && block_->TryIncreaseStrong()) {
+            result.block_ = block_;
+            result.ptr_ = ptr_;
+        }
+        return result;
     }
 
-    ControlBlockBase* block_ = nullptr;
-    T* ptr_ = nullptr;
+    ControlBlockBase<Policy>* block_ = nullptr;
+    ElementType* ptr_ = nullptr;
 };